@@ -3,10 +3,10 @@
  * hcal.c  Hebrew calendar              (part of package libhdate)
  * hdate.c Hebrew date/times information(part of package libhdate)
  *
- * compile:
- *     gcc -c -Wall -Werror -g tzif-display.c
- * build:
- *     gcc -Wall tzif-display.c -o tzif-display
+ * compile: (presumes zdfmt.h and zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -g tzif-display.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall tzif-display.c -o tzif-display -lzdump3
  * run:
  *     ./tzif-display full-pathname-to-tzif-file
  *
@@ -31,10 +31,10 @@
 #include <stdlib.h>		/// For malloc, free
 #include <error.h>		/// For error
 #include <errno.h>		/// For errno
-#include <string.h>		/// for memset, memcpy, memmem
+#include <string.h>		/// for memset, memcpy, memcmp
 #include <sys/stat.h>	/// for stat
 #include <locale.h>		/// for setlocale
-#include <time.h>       /// for ctime_r, tzset
+#include <zdfmt.h>      /// for zdfmt_time
 
 #define TRUE -1
 #define FALSE 0
@@ -44,7 +44,7 @@
 ***************************************************/
 #define HEADER_LEN 44
 typedef struct {
-	char magicnumber[6];	  // = TZif2 or TZif\0
+	char magicnumber[6];	  // = TZif2, TZif3, TZif4 or TZif\0
 //	char reserved[15];		  // nulls
 	long unsigned ttisgmtcnt; // number of UTC/local indicators stored in the file.
 	long unsigned ttisstdcnt; // number of standard/wall indicators stored in the file.
@@ -114,40 +114,63 @@ int read_tz_header( timezonefileheader *header,  const char *temp_buffer)
 		return FALSE;
 	}
 
+	/// a fixed-offset zone (eg. UTC, Etc/GMT+5) has none
 	if (header->timecnt == 0)
-	{
-		printf("No transition times recorded in this file\n");
-		return FALSE;
-	}
+		printf("No transition times recorded in this file\n\n");
 
 return TRUE;
 }
 
 /***********************************************************************
-* tzif2_handle
+* tzif_data_size - bytes of data following a header
+***********************************************************************/
+unsigned long long tzif_data_size( const timezonefileheader *tzh, const int field_size )
+{
+	/// a leap second record is a transition time and a 4-byte correction
+	return ((unsigned long long) tzh->timecnt * (field_size + 1)) +
+		   ((unsigned long long) tzh->typecnt * 6) + tzh->charcnt +
+		   ((unsigned long long) tzh->leapcnt * (field_size + 4)) +
+		   tzh->ttisstdcnt + tzh->ttisgmtcnt;
+}
+
+/***********************************************************************
+* tzif2_handle - versions 2, 3 and 4
 ***********************************************************************/
 char* tzif2_handle( timezonefileheader *tzh, const char *tzfile_buffer_ptr, size_t buffer_size )
 {
-	char *start_ptr;
-	char magicnumber[5] = "TZif2";
+	/// the second header directly follows the version 1 data, whose size
+	/// is known from the first header
+	unsigned long long offset;
+	char version = tzh->magicnumber[4];
 
-	printf("handle format 2\n");
+	printf("handle format %c\n", version);
 
-	start_ptr = memmem( tzfile_buffer_ptr, buffer_size, &magicnumber, 5 );
-	if (start_ptr == NULL)
+	offset = HEADER_LEN + tzif_data_size( tzh, TZIF1_FIELD_SIZE );
+	if (offset + HEADER_LEN > buffer_size)
+	{
+		printf("file truncated before tzif%c header\n", version);
+		return NULL;
+	}
+	if (memcmp( &tzfile_buffer_ptr[offset], tzfile_buffer_ptr, 5 ))
 	{
-		printf("error finding tzif2 header\n");
+		printf("error finding tzif%c header\n", version);
 		return NULL;
 	}
 
-	printf("tzif2 header found at position %ld\n", start_ptr - tzfile_buffer_ptr);
-	if ( read_tz_header( tzh, (char*) start_ptr ) == FALSE )
+	printf("tzif%c header found at position %lld\n", version, offset);
+	if ( read_tz_header( tzh, &tzfile_buffer_ptr[offset] ) == FALSE )
 	{
-		printf("Error reading header file version 2\n");
+		printf("Error reading header file version %c\n", version);
 		return NULL;
 	}
 
-	return start_ptr + HEADER_LEN;
+	offset = offset + HEADER_LEN;
+	if (offset + tzif_data_size( tzh, TZIF2_FIELD_SIZE ) > buffer_size)
+	{
+		printf("file truncated within tzif%c data\n", version);
+		return NULL;
+	}
+	return (char*) tzfile_buffer_ptr + offset;
 }
 
 
@@ -161,7 +184,7 @@ void display_tzfile_data(	const timezonefileheader tzh,
 {
 	long i;
 	unsigned long temp_long;
-	char ctime_buffer[200]; /// arbitrarily > 26 bytes
+	char ctime_buffer[200]; /// arbitrarily > 32 bytes
 	long gmtoff;
 
 	 /***************************************************
@@ -301,22 +324,27 @@ void display_tzfile_data(	const timezonefileheader tzh,
 
 	/// Print transition times
 	printf("\n List of transition times\n #    epoch     local_time_type  human-readable_time\n");
-	temp_transition_time_ptr = (char *) transition_time_ptr + ((tzh.timecnt-1) * field_size);
-	temp_local_time_ptr = (char *) local_time_type_ptr + (tzh.timecnt-1);
-	for (i=tzh.timecnt-1;i>0; i--)
+	if (tzh.timecnt == 0) printf("  (none)\n");
+	else
 	{
-		temp_ttinfo_data_ptr = ttinfo_data_ptr + *temp_local_time_ptr;
-		temp_long = parse_tz_long( temp_transition_time_ptr, field_size );
-		long temp_local_time = temp_long  + temp_ttinfo_data_ptr->gmtoff;
-		if ( asctime_r( gmtime( (const time_t *) &temp_local_time), (char*) &ctime_buffer) == NULL )
+		temp_transition_time_ptr = (char *) transition_time_ptr + ((tzh.timecnt-1) * field_size);
+		temp_local_time_ptr = (char *) local_time_type_ptr + (tzh.timecnt-1);
+		for (i=tzh.timecnt-1;i>0; i--)
 		{
-			error(0,errno,"error returned by ctime_r in transition time data\n");
-			free(ttinfo_data_ptr);
-			return;
+			temp_ttinfo_data_ptr = ttinfo_data_ptr + *temp_local_time_ptr;
+			temp_long = parse_tz_long( temp_transition_time_ptr, field_size );
+			long temp_local_time = temp_long  + temp_ttinfo_data_ptr->gmtoff;
+			if ( zdfmt_time( ctime_buffer, sizeof(ctime_buffer), ZDFMT_ASCTIME "\n",
+							 temp_local_time, 0, NULL) == 0 )
+			{
+				error(0,errno,"error formatting transition time data\n");
+				free(ttinfo_data_ptr);
+				return;
+			}
+			printf("%3ld: %11ld    -- %2d ---     %s",i, temp_long, *temp_local_time_ptr, (char*) &ctime_buffer);
+			temp_transition_time_ptr = temp_transition_time_ptr - field_size;
+			temp_local_time_ptr = temp_local_time_ptr - 1;
 		}
-		printf("%3ld: %11ld    -- %2d ---     %s",i, temp_long, *temp_local_time_ptr, (char*) &ctime_buffer);
-		temp_transition_time_ptr = temp_transition_time_ptr - field_size;
-		temp_local_time_ptr = temp_local_time_ptr - 1;
 	}
 
 
@@ -330,21 +358,22 @@ void display_tzfile_data(	const timezonefileheader tzh,
 		{
 			leapinfo.when = parse_tz_long( temp_leapinfo_ptr, field_size );
 			temp_leapinfo_ptr = temp_leapinfo_ptr +field_size;
-			leapinfo.amt = parse_tz_long( temp_leapinfo_ptr, field_size );
-			if ( ctime_r( (const time_t *) &leapinfo.when, (char*) &ctime_buffer) == NULL )
+			leapinfo.amt = parse_tz_long( temp_leapinfo_ptr, 4 );
+			if ( zdfmt_time( ctime_buffer, sizeof(ctime_buffer), ZDFMT_ASCTIME " UTC",
+							 leapinfo.when, 0, NULL) == 0 )
 			{
-				error(0,errno,"error returned by ctime_r in leapinfo data\n");
+				error(0,errno,"error formatting leapinfo data\n");
 				free(ttinfo_data_ptr);
 				return;
 			}
 			printf("%ld: %ld        %s     %ld\n",
 					i, leapinfo.when, (char*) &ctime_buffer, leapinfo.amt );
-			temp_leapinfo_ptr = temp_leapinfo_ptr +field_size;
+			temp_leapinfo_ptr = temp_leapinfo_ptr + 4;
 		}
 	}
 
 
-	wall_indicator_ptr = leapinfo_ptr + (tzh.leapcnt*field_size*2);
+	wall_indicator_ptr = leapinfo_ptr + (tzh.leapcnt*(field_size+4));
 	if (tzh.ttisstdcnt != 0)
 	{
 		temp_wall_indicator_ptr = wall_indicator_ptr;
@@ -450,7 +479,8 @@ hints: /usr/share/zoneinfo/{continent}/{city}\n\
 	printf("Data for file: %s\n",argv[1]);
 	printf("file size is %ld bytes\n\n", file_status.st_size);
 
-	tzif_buffer_ptr = (char *) malloc( file_status.st_size );
+	/// terminated, so that the search for the general rule stops at the end
+	tzif_buffer_ptr = (char *) malloc( file_status.st_size + 1 );
 	if (tzif_buffer_ptr == NULL)
 	{
 		printf("memory allocation error - tzif buffer\n");
@@ -464,7 +494,15 @@ hints: /usr/share/zoneinfo/{continent}/{city}\n\
 		exit(errno);
 	}
 	fclose(tz_file);
+	tzif_buffer_ptr[file_status.st_size] = '\0';
+
 
+	if ((file_status.st_size < HEADER_LEN) || memcmp( tzif_buffer_ptr, "TZif", 4 ))
+	{
+		printf("not a tzif file, or truncated before its header\n");
+		free(tzif_buffer_ptr);
+		exit(1);
+	}
 
 	if ( read_tz_header( &tzh, tzif_buffer_ptr ) == FALSE )
 	{
@@ -472,11 +510,21 @@ hints: /usr/share/zoneinfo/{continent}/{city}\n\
 		exit(errno);
 	}
 
-	if (tzh.magicnumber[4] == 50 )
+	if ((tzh.magicnumber[4] >= '2') && (tzh.magicnumber[4] <= '4'))
 	{
-		start_ptr = tzif2_handle( &tzh, &tzif_buffer_ptr[HEADER_LEN], file_status.st_size - HEADER_LEN);
+		start_ptr = tzif2_handle( &tzh, tzif_buffer_ptr, file_status.st_size );
 		field_size = TZIF2_FIELD_SIZE;
 	}
+	else if (tzh.magicnumber[4] != '\0')
+	{
+		printf("unsupported tzif format version %c\n", tzh.magicnumber[4]);
+		start_ptr = NULL;
+	}
+	else if (HEADER_LEN + tzif_data_size( &tzh, TZIF1_FIELD_SIZE ) > file_status.st_size)
+	{
+		printf("file truncated within tzif data\n");
+		start_ptr = NULL;
+	}
 	else
 	{
 		start_ptr = &tzif_buffer_ptr[HEADER_LEN];
@@ -0,0 +1,510 @@
+ /** zdcache.c                          http://libhdate.sourceforge.net
+ *   zdcache - process-wide cache of parsed zones, and prefetch into it
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC -pthread zdcache.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc
+#include <string.h> 	/// for strcmp, strdup
+#include <stdint.h>		/// for uintptr_t
+#include <pthread.h>	/// for pthread_create, pthread_mutex_lock
+#include "zdcache.h"
+#include "zdnames.h"		/// for zdnames_canonical
+
+#define ZDCACHE_BUCKETS 256
+#define LOCALTIME_NAME "localtime"	/// the key of tzname NULL
+
+/// zdcache_timelines - the timelines built for a cached zone, the widest
+/// horizon first. Narrower ones may still be held, so are kept until the
+/// zone is freed.
+typedef struct zdcache_timelines {
+	zdtimeline	*timeline;
+	struct zdcache_timelines *next;
+	} zdcache_timelines;
+
+/// zdcache_entry - one cached zone, in a chain of each table
+typedef struct zdcache_entry {
+	char		*name;
+	zdzone		*zone;
+	zdcache_timelines *timelines;
+	int			posix;		/// name is a POSIX TZ string, not a file
+	int			refs;
+	int			stale;		/// removed from by_name, freed at refs 0
+	size_t		bytes;		/// of the zone, its timelines, and the entry
+	struct zdcache_entry *next_by_name;
+	struct zdcache_entry *next_by_zone;
+	struct zdcache_entry *newer;	/// in the recency list, while in by_name
+	struct zdcache_entry *older;
+	} zdcache_entry;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static zdcache_entry* by_name[ZDCACHE_BUCKETS];
+static zdcache_entry* by_zone[ZDCACHE_BUCKETS];
+
+/// the recency list runs from the sentinel's 'older' (most recently
+/// used) to its 'newer' (least); eviction walks it from the least
+static zdcache_entry recency = { .newer = &recency, .older = &recency };
+static zdcache_stats stats;
+
+struct zdprefetch {
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int				num_zones;
+	char			**zones;	/// copies; NULL elements stay NULL
+	int				done;
+	int				stop;
+	int				result;		/// of the first zone that failed
+	};
+
+
+static unsigned int name_hash( const char* name )
+{
+	/// FNV-1a
+	unsigned int hash = 2166136261u;
+
+	while (*name)
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+	return hash % ZDCACHE_BUCKETS;
+}
+
+static unsigned int zone_hash( const zdzone* zone )
+{
+	return ((uintptr_t) zone / sizeof(void*)) % ZDCACHE_BUCKETS;
+}
+
+static zdcache_entry* name_lookup( const char* name, const int posix )
+{
+	/// called with cache_lock held. Zone names and POSIX TZ strings are
+	/// kept apart, "EST5EDT" being both
+	zdcache_entry* entry = by_name[ name_hash(name) ];
+
+	while ((entry != NULL) && ((entry->posix != posix) || strcmp( entry->name, name )))
+		entry = entry->next_by_name;
+	return entry;
+}
+
+static zdcache_entry* zone_lookup( const zdzone* zone )
+{
+	/// called with cache_lock held
+	zdcache_entry* entry = by_zone[ zone_hash(zone) ];
+
+	while ((entry != NULL) && (entry->zone != zone)) entry = entry->next_by_zone;
+	return entry;
+}
+
+static void recency_unlink( zdcache_entry* entry )
+{
+	entry->newer->older = entry->older;
+	entry->older->newer = entry->newer;
+}
+
+static void recency_push( zdcache_entry* entry )
+{
+	/// make entry the most recently used
+	entry->newer = &recency;
+	entry->older = recency.older;
+	recency.older->newer = entry;
+	recency.older = entry;
+}
+
+static void entry_used( zdcache_entry* entry )
+{
+	/// called with cache_lock held, on every lookup that finds entry
+	entry->refs++;
+	stats.hits++;
+	if (recency.older == entry) return;
+	recency_unlink(entry);
+	recency_push(entry);
+}
+
+static void entry_free( zdcache_entry* entry )
+{
+	/// called with cache_lock held, for an entry no longer in by_name
+	zdcache_entry** link = &by_zone[ zone_hash(entry->zone) ];
+	zdcache_timelines* timelines;
+
+	while (*link != entry) link = &(*link)->next_by_zone;
+	*link = entry->next_by_zone;
+	stats.bytes -= entry->bytes;
+	while (entry->timelines != NULL)
+	{
+		timelines = entry->timelines;
+		entry->timelines = timelines->next;
+		zdtimeline_free(timelines->timeline);
+		free(timelines);
+	}
+	zdzone_free(entry->zone);
+	free(entry->name);
+	free(entry);
+}
+
+static void entry_drop( zdcache_entry* entry )
+{
+	/// called with cache_lock held: remove entry from by_name, freeing it
+	/// now if no reader holds it, else at its last zdcache_put()
+	zdcache_entry** link = &by_name[ name_hash(entry->name) ];
+
+	while (*link != entry) link = &(*link)->next_by_name;
+	*link = entry->next_by_name;
+	recency_unlink(entry);
+	entry->stale = 1;
+	stats.num_zones--;
+	if (!entry->refs) entry_free(entry);
+}
+
+static void cache_evict( void )
+{
+	/// called with cache_lock held: drop the least recently used zones
+	/// that no reader holds, until within the limit
+	zdcache_entry* entry = recency.newer;
+	zdcache_entry* newer;
+
+	while (stats.limit && (stats.bytes > stats.limit) && (entry != &recency))
+	{
+		newer = entry->newer;
+		if (!entry->refs)
+		{
+			entry_drop(entry);
+			stats.evictions++;
+		}
+		entry = newer;
+	}
+}
+
+
+static int cache_get( char* name, const int posix, const zdzone** zone )
+{
+	/// name is a zone name (NULL being localtime), or a POSIX TZ string.
+	/// A zone name is cached under its canonical name, so that aliases
+	/// share one zone
+	const char* key;
+	zdcache_entry* entry;
+	zdcache_entry* found;
+	unsigned int bucket;
+	int result;
+
+	if (!posix) name = (char*) zdnames_canonical(name);
+	key = name != NULL ? name : LOCALTIME_NAME;
+	pthread_mutex_lock(&cache_lock);
+	found = name_lookup(key, posix);
+	if (found != NULL)
+	{
+		entry_used(found);
+		*zone = found->zone;
+	}
+	else stats.misses++;
+	pthread_mutex_unlock(&cache_lock);
+	if (found != NULL) return ZD_SUCCESS;
+
+	/// parse without holding the lock; should another thread cache the
+	/// same zone meanwhile, use its copy instead
+	entry = calloc( 1, sizeof(zdcache_entry) );
+	if (entry == NULL) return ZD_MALLOC;
+	entry->posix = posix;
+	entry->name = strdup(key);
+	if (entry->name == NULL) {result= ZD_MALLOC; goto failure;};
+	if (posix) result = zdzone_posix( name, &entry->zone );
+	else result = zdzone_load( name, &entry->zone );
+	if (result != ZD_SUCCESS) goto failure;
+	entry->bytes = sizeof(zdcache_entry) + strlen(entry->name) + 1 + zdzone_size(entry->zone);
+
+	pthread_mutex_lock(&cache_lock);
+	found = name_lookup(key, posix);
+	if (found == NULL)
+	{
+		bucket = name_hash(key);
+		entry->next_by_name = by_name[bucket];
+		by_name[bucket] = entry;
+		bucket = zone_hash(entry->zone);
+		entry->next_by_zone = by_zone[bucket];
+		by_zone[bucket] = entry;
+		recency_push(entry);
+		stats.bytes += entry->bytes;
+		stats.num_zones++;
+		entry->refs++;
+		*zone = entry->zone;
+		entry = NULL;
+		cache_evict();
+	}
+	else
+	{
+		found->refs++;
+		*zone = found->zone;
+	}
+	pthread_mutex_unlock(&cache_lock);
+	if (entry == NULL) return ZD_SUCCESS;
+	result = ZD_SUCCESS;
+
+failure:
+	zdzone_free(entry->zone);
+	free(entry->name);
+	free(entry);
+	return result;
+}
+
+int zdcache_get( char* tzname, const zdzone** zone )
+{
+	return cache_get( tzname, 0, zone );
+}
+
+int zdcache_posix( const char* tz, const zdzone** zone )
+{
+	*zone = NULL;
+	if (tz == NULL) return ZD_TZ_STRING;
+	return cache_get( (char*) tz, 1, zone );
+}
+
+const zdzone* zdcache_find( char* tzname )
+{
+	zdcache_entry* entry;
+	const zdzone* zone = NULL;
+
+	tzname = (char*) zdnames_canonical(tzname);
+	pthread_mutex_lock(&cache_lock);
+	entry = name_lookup( tzname != NULL ? tzname : LOCALTIME_NAME, 0 );
+	if (entry != NULL)
+	{
+		entry_used(entry);
+		zone = entry->zone;
+	}
+	pthread_mutex_unlock(&cache_lock);
+	return zone;
+}
+
+void zdcache_put( const zdzone* zone )
+{
+	zdcache_entry* entry;
+
+	if (zone == NULL) return;
+	pthread_mutex_lock(&cache_lock);
+	entry = zone_lookup(zone);
+	if (entry != NULL)
+	{
+		entry->refs--;
+		if (entry->stale && !entry->refs) entry_free(entry);
+		else if (!entry->refs) cache_evict();
+	}
+	pthread_mutex_unlock(&cache_lock);
+}
+
+int zdcache_timeline( char* tzname, const long horizon, const zdtimeline** timeline )
+{
+	const zdzone* zone;
+	zdcache_entry* entry;
+	zdcache_timelines* timelines = NULL;
+	zdtimeline* built = NULL;
+	int result;
+
+	*timeline = NULL;
+	result = zdcache_get( tzname, &zone );
+	if (result != ZD_SUCCESS) return result;
+
+	/// build without holding the lock, as for zdcache_get()
+	pthread_mutex_lock(&cache_lock);
+	entry = zone_lookup(zone);
+	if ((entry->timelines != NULL) && (entry->timelines->timeline->horizon >= horizon))
+		*timeline = entry->timelines->timeline;
+	pthread_mutex_unlock(&cache_lock);
+	if (*timeline != NULL) return ZD_SUCCESS;
+
+	result = zdtimeline_build( zone, horizon, &built );
+	if (result == ZD_SUCCESS)
+	{
+		timelines = malloc( sizeof(zdcache_timelines) );
+		if (timelines == NULL) result = ZD_MALLOC;
+	}
+	if (result != ZD_SUCCESS)
+	{
+		zdtimeline_free(built);
+		zdcache_put(zone);
+		return result;
+	}
+	pthread_mutex_lock(&cache_lock);
+	if ((entry->timelines != NULL) && (entry->timelines->timeline->horizon >= horizon))
+		*timeline = entry->timelines->timeline;
+	else
+	{
+		timelines->timeline = built;
+		timelines->next = entry->timelines;
+		entry->timelines = timelines;
+		entry->bytes += sizeof(zdcache_timelines) + zdtimeline_size(built);
+		stats.bytes += sizeof(zdcache_timelines) + zdtimeline_size(built);
+		cache_evict();
+		*timeline = built;
+		built = NULL;
+		timelines = NULL;
+	}
+	pthread_mutex_unlock(&cache_lock);
+	zdtimeline_free(built);
+	free(timelines);
+	return ZD_SUCCESS;
+}
+
+int zdcache_drop( char* tzname )
+{
+	zdcache_entry* entry;
+
+	tzname = (char*) zdnames_canonical(tzname);
+	pthread_mutex_lock(&cache_lock);
+	entry = name_lookup( tzname != NULL ? tzname : LOCALTIME_NAME, 0 );
+	if (entry != NULL) entry_drop(entry);
+	pthread_mutex_unlock(&cache_lock);
+	return entry != NULL;
+}
+
+void zdcache_clear( void )
+{
+	zdcache_entry* entry;
+	zdcache_entry* next;
+	int i;
+
+	pthread_mutex_lock(&cache_lock);
+	for (i=0; i<ZDCACHE_BUCKETS; i++)
+		for (entry = by_name[i]; entry != NULL; entry = next)
+		{
+			next = entry->next_by_name;
+			entry_drop(entry);
+		}
+	pthread_mutex_unlock(&cache_lock);
+}
+
+void zdcache_limit( const size_t bytes )
+{
+	pthread_mutex_lock(&cache_lock);
+	stats.limit = bytes;
+	cache_evict();
+	pthread_mutex_unlock(&cache_lock);
+}
+
+void zdcache_usage( zdcache_stats* usage )
+{
+	pthread_mutex_lock(&cache_lock);
+	*usage = stats;
+	pthread_mutex_unlock(&cache_lock);
+}
+
+
+static void* prefetch_thread( void* arg )
+{
+	zdprefetch* handle = arg;
+	const zdzone* zone;
+	int stop = 0;
+	int result;
+	int i;
+
+	for (i=0; (i < handle->num_zones) && !stop; i++)
+	{
+		result = zdcache_get( handle->zones[i], &zone );
+		if (result == ZD_SUCCESS) zdcache_put(zone);
+		pthread_mutex_lock(&handle->lock);
+		if ((result != ZD_SUCCESS) && (handle->result == ZD_SUCCESS))
+			handle->result = result;
+		stop = handle->stop;
+		pthread_mutex_unlock(&handle->lock);
+	}
+	pthread_mutex_lock(&handle->lock);
+	handle->done = 1;
+	pthread_cond_broadcast(&handle->cond);
+	pthread_mutex_unlock(&handle->lock);
+	return NULL;
+}
+
+static void prefetch_release( zdprefetch* handle )
+{
+	int i;
+
+	for (i=0; i<handle->num_zones; i++) free(handle->zones[i]);
+	free(handle->zones);
+	pthread_cond_destroy(&handle->cond);
+	pthread_mutex_destroy(&handle->lock);
+	free(handle);
+}
+
+int zdump_prefetch( char** zones, const int num_zones, zdprefetch** handle )
+{
+	zdprefetch* pf;
+	int i;
+
+	*handle = NULL;
+	if (num_zones <= 0) return ZD_ZONE_COUNT;
+	pf = calloc( 1, sizeof(zdprefetch) );
+	if (pf == NULL) return ZD_MALLOC;
+	pthread_mutex_init( &pf->lock, NULL );
+	pthread_cond_init( &pf->cond, NULL );
+	pf->zones = calloc( num_zones, sizeof(char*) );
+	if (pf->zones == NULL)
+	{
+		prefetch_release(pf);
+		return ZD_MALLOC;
+	}
+	pf->num_zones = num_zones;
+	for (i=0; i<num_zones; i++) if (zones[i] != NULL)
+	{
+		pf->zones[i] = strdup(zones[i]);
+		if (pf->zones[i] == NULL)
+		{
+			prefetch_release(pf);
+			return ZD_MALLOC;
+		}
+	}
+	if (pthread_create( &pf->thread, NULL, prefetch_thread, pf ))
+	{
+		prefetch_release(pf);
+		return ZD_FAILURE;
+	}
+	*handle = pf;
+	return ZD_SUCCESS;
+}
+
+int zdprefetch_done( zdprefetch* handle )
+{
+	int done;
+
+	pthread_mutex_lock(&handle->lock);
+	done = handle->done;
+	pthread_mutex_unlock(&handle->lock);
+	return done;
+}
+
+int zdprefetch_wait( zdprefetch* handle )
+{
+	int result;
+
+	pthread_mutex_lock(&handle->lock);
+	while (!handle->done) pthread_cond_wait( &handle->cond, &handle->lock );
+	result = handle->result;
+	pthread_mutex_unlock(&handle->lock);
+	return result;
+}
+
+void zdprefetch_free( zdprefetch* handle )
+{
+	if (handle == NULL) return;
+	pthread_mutex_lock(&handle->lock);
+	handle->stop = 1;
+	pthread_mutex_unlock(&handle->lock);
+	pthread_join( handle->thread, NULL );
+	prefetch_release(handle);
+}
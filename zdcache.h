@@ -0,0 +1,142 @@
+/** zdcache.h           http://libhdate.sourceforge.net
+ * Process-wide cache of parsed zones, and background prefetch into it.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDCACHE_H
+#define ZDCACHE_H
+#include "zdump3.h"		/// for zdzone
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The cache is keyed by zone name exactly as passed (NULL being the
+/// system's current timezone), or by its canonical name while a zdnames
+/// index is in use, or by POSIX TZ string, and is shared by all threads.
+/// zdump() and zdump_multi() use a cached zone when there is one, but do
+/// not add to the cache; zdcache_get() and zdump_prefetch() do. Each zone
+/// obtained from the cache holds a reference, which must be returned with
+/// zdcache_put(); a referenced zone is never freed, even by zdcache_clear().
+
+extern int
+zdcache_get(             /// returns 0 on success, error code on failure
+    char* tzname,        /// as for zdump()
+    const zdzone** zone  /// upon successful return, the cached zone,
+                         ///    parsed now if it was not already cached
+           );
+
+extern int
+zdcache_posix(           /// returns 0 on success, error code on failure
+    const char* tz,      /// a POSIX TZ string, as for zdzone_posix()
+    const zdzone** zone  /// upon successful return, the cached zone for
+                         ///    that string, decoded now if it was not
+                         ///    already cached. Return it with zdcache_put().
+             );
+
+extern const zdzone*
+zdcache_find(            /// returns the cached zone, or NULL if 'tzname'
+    char* tzname         ///    is not cached. Does not parse, nor count a
+                         ///    miss.
+            );
+
+extern void
+zdcache_put( const zdzone* zone );  /// return a reference
+
+extern int
+zdcache_timeline(        /// returns 0 on success, error code on failure
+    char* tzname,        /// as for zdump()
+    const long horizon,  /// as for zdtimeline_build()
+    const zdtimeline** timeline /// upon successful return, a timeline of
+                         ///    the cached zone reaching at least 'horizon',
+                         ///    built now if there was none. It holds a
+                         ///    reference to the zone, to be returned with
+                         ///    zdcache_put( (*timeline)->zone ).
+                );
+
+extern int
+zdcache_drop(            /// returns 1 if the zone was cached, else 0
+    char* tzname         /// as for zdump(); drop that zone only (eg. one
+                         ///    changed by a tzdata update), so that it is
+                         ///    parsed anew. A referenced zone is freed by
+                         ///    its last zdcache_put().
+            );
+
+extern void
+zdcache_clear( void );   /// drop every zone; those still referenced are
+                         ///    freed by their last zdcache_put()
+
+
+/// The cache is unbounded unless given a limit in bytes. Each zone is
+/// accounted for its transitions, local time types (with their
+/// abbreviations), footer rule and the timelines built from it. Beyond
+/// the limit, the least recently used zones that no reader holds are
+/// dropped; a held zone is never freed, so the cache may stay over its
+/// limit while every zone in it is held. With a limit set, or a name
+/// index in use (see zdnames.h), zdump() and zdump_multi() also cache the
+/// zones they parse.
+typedef struct {
+	size_t		limit;			/// 0 when unbounded
+	size_t		bytes;			/// held by zones in the cache, and by those
+								///    dropped from it but still referenced
+	int			num_zones;		/// in the cache
+	long		hits;			/// lookups finding their zone cached
+	long		misses;			/// lookups that parsed their zone instead
+	long		evictions;		/// zones dropped for the limit
+	} zdcache_stats;
+
+extern void
+zdcache_limit( const size_t bytes );   /// set the limit, evicting at once
+                         ///    as needed; 0 removes it
+
+extern void
+zdcache_usage( zdcache_stats* usage );  /// current usage and counters
+
+
+/// zdprefetch - completion handle of a zdump_prefetch()
+typedef struct zdprefetch zdprefetch;
+
+extern int
+zdump_prefetch(          /// returns 0 on success, error code on failure
+    char** zones,        /// array of time-zone names, as for zdump(); copied,
+    const int num_zones, ///    so the caller may release it at once
+    zdprefetch** handle  /// upon successful return, a handle to be released
+                         ///    with zdprefetch_free(). The zones are parsed
+                         ///    into the cache by a background thread.
+              );
+
+extern int
+zdprefetch_done(         /// returns non-zero once every zone has been tried,
+    zdprefetch* handle   ///    without waiting
+               );
+
+extern int
+zdprefetch_wait(         /// waits until every zone has been tried. returns 0
+    zdprefetch* handle   ///    if all were cached, otherwise the error code
+                         ///    of the first that failed
+               );
+
+extern void
+zdprefetch_free(         /// stops the prefetch at the next zone if it has not
+    zdprefetch* handle   ///    finished, waits for the thread, and releases
+                         ///    the handle. Zones already cached remain so.
+               );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDCACHE_H */
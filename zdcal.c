@@ -0,0 +1,149 @@
+ /** zdcal.c                            http://libhdate.sourceforge.net
+ *   zdcal - DST calendar of every zone, over a range of years
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -O2 zdcal.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -O2 zdcal.c -o zdcal -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH \
+ *     ./zdcal [-b] [-j threads] [-d tzdir] first_year last_year > calendar
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>		/// for printf, fwrite
+#include <stdlib.h>		/// for atol, free
+#include <string.h>		/// for memset, strncpy
+#include <stdint.h>		/// for int64_t
+#include <unistd.h>		/// for getopt
+#include <zdump3.h>		/// for zddb_load
+#include <zdfmt.h>		/// for zdfmt_time
+#include <zdcalendar.h>	/// for zdump_calendar
+
+/// binary output, in host byte order: the header, then num_zones zone
+/// names each terminated by '\0', then num_entries records
+#define ZDCAL_MAGIC "ZDCAL1\n"
+typedef struct {
+	char		magic[8];		/// ZDCAL_MAGIC
+	uint32_t	num_zones;
+	uint32_t	num_entries;
+	} zdcal_header;
+
+typedef struct {
+	int64_t		start;			/// seconds from epoch
+	int32_t		zone_id;		/// index of the zone's name
+	int32_t		utc_offset;
+	int32_t		save_secs;
+	char		abbr[12];		/// terminated with '\0'
+	} zdcal_record;
+
+#define OUTPUT_BUFFER (1 << 20)
+
+
+static void write_csv( const zddb* db, const zdmultiinfo* entries, const int num_entries )
+{
+	char utc[32], local[32];
+	int i;
+
+	printf("time_t,utc,local,zone,utc_offset,save_secs,abbr\n");
+	for (i=0; i<num_entries; i++)
+	{
+		zdfmt_time( utc, sizeof(utc), "%Y-%m-%dT%H:%M:%SZ", entries[i].info.start, 0, NULL );
+		zdfmt_entry( local, sizeof(local), ZDFMT_ISO8601, &entries[i].info );
+		printf("%ld,%s,%s,%s,%d,%d,%s\n", (long) entries[i].info.start, utc, local,
+			   db->names[ entries[i].zone_id ], entries[i].info.utc_offset,
+			   entries[i].info.save_secs, entries[i].info.abbr);
+	}
+}
+
+static void write_binary( const zddb* db, const zdmultiinfo* entries, const int num_entries )
+{
+	zdcal_header header;
+	zdcal_record record;
+	int i;
+
+	memset( &header, '\0', sizeof(header) );
+	memcpy( header.magic, ZDCAL_MAGIC, sizeof(header.magic) );
+	header.num_zones = db->num_zones;
+	header.num_entries = num_entries;
+	fwrite( &header, sizeof(header), 1, stdout );
+	for (i=0; i<db->num_zones; i++) fwrite( db->names[i], strlen(db->names[i]) + 1, 1, stdout );
+	for (i=0; i<num_entries; i++)
+	{
+		memset( &record, '\0', sizeof(record) );
+		record.start = entries[i].info.start;
+		record.zone_id = entries[i].zone_id;
+		record.utc_offset = entries[i].info.utc_offset;
+		record.save_secs = entries[i].info.save_secs;
+		strncpy( record.abbr, entries[i].info.abbr, MAX_TZ_ABBR_SIZE );
+		fwrite( &record, sizeof(record), 1, stdout );
+	}
+}
+
+
+int main (int argc, char *argv[])
+{
+	zddb* db;
+	void* data = NULL;
+	const char* tzdir = NULL;
+	int binary = 0;
+	int num_threads = 0;
+	int num_entries;
+	int opt, result;
+
+	while ((opt = getopt( argc, argv, "bj:d:" )) != -1)
+	{
+		switch (opt)
+		{
+		case 'b': binary = 1; break;
+		case 'j': num_threads = atoi(optarg); break;
+		case 'd': tzdir = optarg; break;
+		default:  argc = 0; break;
+		}
+	}
+	if (argc - optind != 2)
+	{
+		printf("\
+zdcal: DST calendar of every zone, over a range of years\n\
+usage: ./zdcal [-b] [-j threads] [-d tzdir] first_year last_year\n\
+       writes every transition of every zone of tzdir (default, TZDIR or\n\
+       the system zoneinfo directory) from the start of first_year to\n\
+       the end of last_year (UTC), in chronological order, as CSV or\n\
+       with -b as binary records\n");
+		exit(0);
+	}
+
+	result = zddb_load( tzdir, &db );
+	if (result != ZD_SUCCESS)
+	{
+		fprintf(stderr, "zdcal: error %d loading the zoneinfo directory\n", result);
+		exit(1);
+	}
+	result = zdump_calendar( db, atol(argv[optind]), atol(argv[optind+1]), num_threads,
+							 &num_entries, &data );
+	if (result != ZD_SUCCESS)
+	{
+		fprintf(stderr, "zdcal: error %d\n", result);
+		exit(1);
+	}
+	setvbuf( stdout, NULL, _IOFBF, OUTPUT_BUFFER );
+	if (binary) write_binary( db, data, num_entries );
+	else write_csv( db, data, num_entries );
+	fflush(stdout);
+	free(data);
+	zddb_free(db);
+	exit(ferror(stdout) != 0);
+}
@@ -0,0 +1,284 @@
+ /** zdcalendar.c                       http://libhdate.sourceforge.net
+ *   zdcalendar - every transition of every zone, over a range of years
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC -pthread zdcalendar.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc, qsort
+#include <string.h> 	/// for memcmp, memcpy
+#include <unistd.h>		/// for sysconf
+#include <pthread.h>	/// for pthread_create
+#include "zdcalendar.h"
+
+/// calendar_rule - one distinct footer rule, and its edges in the range
+typedef struct {
+	const rule_detail *rule;
+	int			num_entries;
+	zdumpinfo	*entries;
+	} calendar_rule;
+
+/// calendar_zone - the transitions of one zone in the range
+typedef struct {
+	int			num_entries;
+	zdmultiinfo	*entries;
+	} calendar_zone;
+
+/// calendar_work - shared by the threads of the pool, which take items
+/// (rules, then zones) one at a time until none are left, so that a
+/// thread finishing a small zone goes on to the next without waiting
+typedef struct calendar_work {
+	pthread_mutex_t	lock;
+	int				next;		/// next item to take
+	int				num_items;
+	void			(*run)( struct calendar_work* work, const int item );
+	int				result;		/// of the first item that failed
+	const zddb		*db;
+	time_t			start;
+	time_t			end;		/// transitions before this
+	int				num_rules;
+	calendar_rule	*rules;
+	int				*rule_of;	/// [num_zones] index into rules, or -1
+	calendar_zone	*zones;		/// [num_zones]
+	} calendar_work;
+
+
+static void work_failed( calendar_work* work, const int result )
+{
+	pthread_mutex_lock(&work->lock);
+	if (work->result == ZD_SUCCESS) work->result = result;
+	pthread_mutex_unlock(&work->lock);
+}
+
+static void* pool_thread( void* arg )
+{
+	calendar_work* work = arg;
+	int item;
+
+	while (1)
+	{
+		pthread_mutex_lock(&work->lock);
+		item = work->next++;
+		pthread_mutex_unlock(&work->lock);
+		if (item >= work->num_items) return NULL;
+		work->run( work, item );
+	}
+}
+
+static void run_pool( calendar_work* work, const int num_threads, const int num_items,
+					  void (*run)( calendar_work* work, const int item ) )
+{
+	/// the calling thread works too, and finishes alone should no
+	/// other thread start
+	pthread_t* threads;
+	int started = 0;
+
+	work->next = 0;
+	work->num_items = num_items;
+	work->run = run;
+	threads = malloc( sizeof(pthread_t) * num_threads );
+	if (threads != NULL)
+		while ((started < num_threads - 1) &&
+			   !pthread_create( &threads[started], NULL, pool_thread, work ))
+			started++;
+	pool_thread(work);
+	while (started) pthread_join( threads[--started], NULL );
+	free(threads);
+}
+
+static int append( void** entries, int* num_entries, int* max_entries, const size_t size )
+{
+	/// make room for one more entry
+	void* new_entries;
+
+	if (*num_entries < *max_entries) return ZD_SUCCESS;
+	*max_entries = *max_entries ? *max_entries * 2 : 16;
+	new_entries = realloc( *entries, size * *max_entries );
+	if (new_entries == NULL) return ZD_MALLOC;
+	*entries = new_entries;
+	return ZD_SUCCESS;
+}
+
+
+static void expand_rule( calendar_work* work, const int item )
+{
+	/// the rule's own edges in the range, as a zone having no explicit
+	/// transitions would give them
+	calendar_rule* cr = &work->rules[item];
+	zdzone alone;
+	zdspan span;
+	int max_entries = 0;
+
+	memset( &alone, '\0', sizeof(zdzone) );
+	alone.has_rule = 1;
+	alone.rule = *cr->rule;
+	zdzone_span( &alone, work->start, &span );
+	if (span.lo < work->start)
+		if (!zdzone_next_span( &alone, &span )) return;
+	while (span.lo < work->end)
+	{
+		if (append( (void**) &cr->entries, &cr->num_entries, &max_entries,
+					sizeof(zdumpinfo) ) != ZD_SUCCESS)
+		{
+			work_failed( work, ZD_MALLOC );
+			return;
+		}
+		cr->entries[cr->num_entries++] = span.info;
+		if (!zdzone_next_span( &alone, &span )) break;
+	}
+}
+
+static void expand_zone( calendar_work* work, const int item )
+{
+	/// the zone's explicit transitions in the range, then the edges of
+	/// its shared rule that follow the last of them
+	const zdzone* zone = work->db->zones[item];
+	calendar_zone* cz = &work->zones[item];
+	const calendar_rule* cr;
+	time_t last;
+	zdspan span;
+	int max_entries = 0;
+	int more, i;
+
+	zdzone_span( zone, work->start, &span );
+	more = (span.index < zone->timecnt);
+	if (more && (span.lo < work->start))
+		more = zdzone_next_span( zone, &span ) && (span.index < zone->timecnt);
+	while (more && (span.lo < work->end))
+	{
+		if (append( (void**) &cz->entries, &cz->num_entries, &max_entries,
+					sizeof(zdmultiinfo) ) != ZD_SUCCESS)
+		{
+			work_failed( work, ZD_MALLOC );
+			return;
+		}
+		cz->entries[cz->num_entries].zone_id = item;
+		cz->entries[cz->num_entries++].info = span.info;
+		more = zdzone_next_span( zone, &span ) && (span.index < zone->timecnt);
+	}
+
+	if (work->rule_of[item] < 0) return;
+	cr = &work->rules[ work->rule_of[item] ];
+	last = zone->timecnt ? zone->transitions[ zone->timecnt - 1 ] : ZD_TIME_MIN;
+	for (i=0; i<cr->num_entries; i++)
+	{
+		if (cr->entries[i].start <= last) continue;
+		if (append( (void**) &cz->entries, &cz->num_entries, &max_entries,
+					sizeof(zdmultiinfo) ) != ZD_SUCCESS)
+		{
+			work_failed( work, ZD_MALLOC );
+			return;
+		}
+		cz->entries[cz->num_entries].zone_id = item;
+		cz->entries[cz->num_entries++].info = cr->entries[i];
+	}
+}
+
+static int calendar_before( const void* a, const void* b )
+{
+	const zdmultiinfo* x = a;
+	const zdmultiinfo* y = b;
+
+	if (x->info.start != y->info.start) return x->info.start < y->info.start ? -1 : 1;
+	return x->zone_id - y->zone_id;
+}
+
+
+int zdump_calendar( const zddb* db, const long first_year, const long last_year,
+					const int num_threads, int* num_entries, void** return_data )
+{
+	calendar_work work;
+	struct tm year_start;
+	zdmultiinfo* all;
+	long threads = num_threads;
+	int total = 0;
+	int i, j;
+
+	*num_entries = 0;
+	*return_data = NULL;
+	if ((last_year < first_year) || (first_year < 1) || (last_year > INT_MAX - 1900L))
+		return ZD_BAD_VALUES;
+	if (db->num_zones <= 0) return ZD_ZONE_COUNT;
+	if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+
+	memset( &work, '\0', sizeof(work) );
+	pthread_mutex_init( &work.lock, NULL );
+	work.db = db;
+	memset( &year_start, '\0', sizeof(year_start) );
+	year_start.tm_mday = 1;
+	year_start.tm_year = (int) (first_year - 1900);
+	work.start = zdump_timegm( &year_start );
+	year_start.tm_year = (int) (last_year + 1 - 1900);
+	work.end = zdump_timegm( &year_start );
+	work.rules = calloc( db->num_zones, sizeof(calendar_rule) );
+	work.rule_of = malloc( sizeof(int) * db->num_zones );
+	work.zones = calloc( db->num_zones, sizeof(calendar_zone) );
+	if ((work.rules == NULL) || (work.rule_of == NULL) || (work.zones == NULL))
+		{work.result= ZD_MALLOC; goto endpoint;};
+
+	/// the distinct rules having DST; there are seldom more than a few
+	/// dozen, so a linear search of them will do
+	for (i=0; i<db->num_zones; i++)
+	{
+		work.rule_of[i] = -1;
+		if (!db->zones[i]->has_rule || !db->zones[i]->rule.has_dst) continue;
+		for (j=0; j<work.num_rules; j++)
+			if (!memcmp( work.rules[j].rule, &db->zones[i]->rule, sizeof(rule_detail) ))
+				break;
+		if (j == work.num_rules) work.rules[ work.num_rules++ ].rule = &db->zones[i]->rule;
+		work.rule_of[i] = j;
+	}
+
+	run_pool( &work, threads, work.num_rules, expand_rule );
+	if (work.result != ZD_SUCCESS) goto endpoint;
+	run_pool( &work, threads, db->num_zones, expand_zone );
+	if (work.result != ZD_SUCCESS) goto endpoint;
+
+	for (i=0; i<db->num_zones; i++)
+	{
+		if (work.zones[i].num_entries > INT_MAX - total)
+			{work.result= ZD_MALLOC; goto endpoint;};
+		total += work.zones[i].num_entries;
+	}
+	if (!total) {work.result= ZD_FAILURE; goto endpoint;};
+	all = malloc( sizeof(zdmultiinfo) * total );
+	if (all == NULL) {work.result= ZD_MALLOC; goto endpoint;};
+	for (i=0; i<db->num_zones; i++)
+	{
+		memcpy( &all[*num_entries], work.zones[i].entries,
+				sizeof(zdmultiinfo) * work.zones[i].num_entries );
+		*num_entries += work.zones[i].num_entries;
+	}
+	qsort( all, total, sizeof(zdmultiinfo), calendar_before );
+	*return_data = all;
+
+/// cleanup and exit
+endpoint:
+	if (work.zones != NULL)
+		for (i=0; i<db->num_zones; i++) free(work.zones[i].entries);
+	if (work.rules != NULL)
+		for (i=0; i<work.num_rules; i++) free(work.rules[i].entries);
+	free(work.zones);
+	free(work.rules);
+	free(work.rule_of);
+	pthread_mutex_destroy(&work.lock);
+	return work.result;
+}
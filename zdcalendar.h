@@ -0,0 +1,52 @@
+/** zdcalendar.h        http://libhdate.sourceforge.net
+ * Every transition of every zone of a zoneinfo directory, over a range
+ * of years, computed by a pool of threads.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDCALENDAR_H
+#define ZDCALENDAR_H
+#include "zdump3.h"		/// for zddb, zdmultiinfo
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Zones whose footer rules are identical (most of Europe shares one, and
+/// most of North America another) have those rules expanded over the
+/// range once, the expansion being shared by all of them.
+
+extern int
+zdump_calendar(          /// returns 0 on success, error code on failure
+    const zddb* db,      /// the zones, eg. from zddb_load()
+    const long first_year, /// the range, in UTC, from the start of
+    const long last_year,  ///    first_year to the end of last_year
+    const int num_threads, /// 0 for the number of processors
+    int* num_entries,    /// upon successful return, the number of
+                         ///    transitions within the range, of all zones
+    void** return_data   /// upon successful return, a malloc()ed array of
+                         ///    'num_entries' 'zdmultiinfo', zone_id being
+                         ///    the index into db, in ascending chronological
+                         ///    order (ties in zone_id order). Unlike
+                         ///    zdump_multi(), there are no entries for the
+                         ///    state at the start of the range.
+              );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDCALENDAR_H */
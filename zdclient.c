@@ -0,0 +1,217 @@
+ /** zdclient.c                         http://libhdate.sourceforge.net
+ *   zdclient - ask a running zdumpd for zone data
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdclient.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE     /// feature_test_macro - for SOCK_CLOEXEC
+#include <stdio.h>		/// for snprintf
+#include <stdlib.h>		/// for malloc, getenv
+#include <string.h> 	/// for strlen, memset
+#include <errno.h>		/// for errno
+#include <unistd.h>		/// for read, write, close
+#include <sys/socket.h>	/// for socket, connect
+#include <sys/un.h>		/// for sockaddr_un
+#include "zdclient.h"
+
+
+static int io_full( const int fd, void* buffer, size_t len, const int writing )
+{
+	/// transfer all of 'len', through short counts and interruptions.
+	/// returns 0 on success
+	char* next = buffer;
+	ssize_t done;
+
+	while (len)
+	{
+		if (writing) done = send( fd, next, len, MSG_NOSIGNAL );
+		else done = read( fd, next, len );
+		if ((done < 0) && (errno == EINTR)) continue;
+		if (done <= 0) return -1;
+		next += done;
+		len -= done;
+	}
+	return 0;
+}
+
+int zdumpd_socket_path( char* path, const size_t size, int* in_default_dir )
+{
+	const char* env = getenv("ZDUMPD_SOCKET");
+	const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+	int len;
+
+	if (in_default_dir != NULL) *in_default_dir = (env == NULL) || (*env == '\0');
+	if ((env != NULL) && (*env != '\0'))
+		len = snprintf( path, size, "%s", env );
+	else if ((runtime_dir != NULL) && (*runtime_dir == '/'))
+		len = snprintf( path, size, "%s/%s/%s", runtime_dir, ZDUMPD_USER_DIR,
+						ZDUMPD_SOCKET_NAME );
+	else len = snprintf( path, size, "%s/%s", ZDUMPD_RUN_DIR, ZDUMPD_SOCKET_NAME );
+	if ((len < 0) || ((size_t) len >= size)) return ZD_DIR_PATH;
+	return ZD_SUCCESS;
+}
+
+
+static int zdp_connect( void )
+{
+	/// returns a connected socket, or -1 when no zdumpd is listening
+	struct sockaddr_un address;
+	int fd;
+
+	memset( &address, '\0', sizeof(address) );
+	address.sun_family = AF_UNIX;
+	if (zdumpd_socket_path( address.sun_path, sizeof(address.sun_path), NULL ) != ZD_SUCCESS)
+		return -1;
+	fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+	if (fd < 0) return -1;
+	if (connect( fd, (struct sockaddr*) &address, sizeof(address) ))
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int zdp_send( const int fd, const uint32_t op, const char* tzname,
+					 const time_t start, const time_t end,
+					 const time_t* times, const int num_times )
+{
+	/// returns 0 on success
+	zdp_request request;
+	int64_t wire_times[256];
+	int i, n;
+
+	memset( &request, '\0', sizeof(request) );
+	request.magic = ZDP_MAGIC;
+	request.op = op;
+	request.info_size = sizeof(zdumpinfo);
+	request.name_len = tzname != NULL ? strlen(tzname) : 0;
+	request.start = start;
+	request.end = end;
+	request.num_times = num_times;
+	if (io_full( fd, &request, sizeof(request), 1 ) ||
+		io_full( fd, (char*) tzname, request.name_len, 1 ))
+		return -1;
+	if (sizeof(time_t) == sizeof(int64_t))
+		return io_full( fd, (time_t*) times, sizeof(time_t) * num_times, 1 );
+	for (i=0; i<num_times; i+=n)
+	{
+		for (n=0; (n < 256) && (i+n < num_times); n++) wire_times[n] = times[i+n];
+		if (io_full( fd, wire_times, sizeof(int64_t) * n, 1 )) return -1;
+	}
+	return 0;
+}
+
+static int zdp_receive( const int fd, zdp_reply* reply )
+{
+	/// returns 0 on success, with reply->num_entries in range
+	if (io_full( fd, reply, sizeof(zdp_reply), 0 )) return -1;
+	if ((reply->result == ZD_SUCCESS) && (reply->num_entries < 0)) return -1;
+	if (reply->result != ZD_SUCCESS) reply->num_entries = 0;
+	return 0;
+}
+
+
+int zdumpd_zdump( char* tzname, const time_t start, const time_t end,
+				  int* num_entries, void** return_data )
+{
+	zdp_reply reply;
+	int result = ZD_SUCCESS;
+	int fd;
+
+	*num_entries = 0;
+	*return_data = NULL;
+	if (end < start) return ZD_BAD_VALUES;
+	if ((tzname != NULL) && (strlen(tzname) > ZDP_MAX_NAME)) return ZD_FOPEN;
+	fd = zdp_connect();
+	if (fd < 0) return zdump( tzname, start, end, num_entries, return_data );
+
+	if (zdp_send( fd, ZDP_RANGE, tzname, start, end, NULL, 0 ) ||
+		zdp_receive( fd, &reply ))
+		{result= ZD_PROTOCOL; goto endpoint;};
+	result = reply.result;
+	if (result != ZD_SUCCESS) goto endpoint;
+	*return_data = malloc( sizeof(zdumpinfo) * (reply.num_entries + 1) );
+	if (*return_data == NULL) {result= ZD_MALLOC; goto endpoint;};
+	if (io_full( fd, *return_data, sizeof(zdumpinfo) * reply.num_entries, 0 ))
+		{result= ZD_PROTOCOL; goto endpoint;};
+	*num_entries = reply.num_entries;
+
+/// cleanup and exit
+endpoint:
+	close(fd);
+	if ((result != ZD_SUCCESS) || !(*num_entries))
+	{
+		free(*return_data);
+		*return_data = NULL;
+		*num_entries = 0;
+		if (result == ZD_SUCCESS) result = ZD_FAILURE;
+	}
+	return result;
+}
+
+static int lookup_local( char* tzname, const time_t* times, const int num_times,
+						 zdumpinfo* results )
+{
+	zdzone* zone;
+	zdcursor cursor;
+	struct tm tm;
+	int result;
+	int i;
+
+	for (i=0; i<num_times; i++)
+		if (zdump_gmtime_r( times[i], &tm ) == NULL) return ZD_BAD_VALUES;
+	result = zdzone_load( tzname, &zone );
+	if (result != ZD_SUCCESS) return result;
+	zdcursor_init( &cursor, zone );
+	for (i=0; i<num_times; i++) results[i] = *zdcursor_lookup( &cursor, times[i] );
+	zdzone_free(zone);
+	return ZD_SUCCESS;
+}
+
+int zdumpd_lookup( char* tzname, const time_t* times, const int num_times,
+				   zdumpinfo* results )
+{
+	zdp_reply reply;
+	int result = ZD_SUCCESS;
+	int fd;
+	int i, n;
+
+	if (num_times <= 0) return ZD_BAD_VALUES;
+	if ((tzname != NULL) && (strlen(tzname) > ZDP_MAX_NAME)) return ZD_FOPEN;
+	fd = zdp_connect();
+	if (fd < 0) return lookup_local( tzname, times, num_times, results );
+
+	/// larger batches go as several requests over the one connection
+	for (i=0; (i < num_times) && (result == ZD_SUCCESS); i+=n)
+	{
+		n = num_times - i < ZDP_MAX_TIMES ? num_times - i : ZDP_MAX_TIMES;
+		if (zdp_send( fd, ZDP_LOOKUP, tzname, 0, 0, &times[i], n ) ||
+			zdp_receive( fd, &reply ))
+			result = ZD_PROTOCOL;
+		else if (reply.result != ZD_SUCCESS) result = reply.result;
+		else if ((reply.num_entries != n) ||
+				 io_full( fd, &results[i], sizeof(zdumpinfo) * n, 0 ))
+			result = ZD_PROTOCOL;
+	}
+	close(fd);
+	return result;
+}
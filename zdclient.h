@@ -0,0 +1,106 @@
+/** zdclient.h          http://libhdate.sourceforge.net
+ * Ask a running zdumpd for zone data, instead of parsing TZif files in
+ * every process.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDCLIENT_H
+#define ZDCLIENT_H
+#include <stdint.h>		/// for uint32_t, int64_t
+#include "zdump3.h"		/// for zdumpinfo
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// the daemon's socket, unless the environment variable ZDUMPD_SOCKET
+/// names another, is ZDUMPD_SOCKET_NAME in a directory of mode 0700 owned
+/// by the daemon: ZDUMPD_USER_DIR below $XDG_RUNTIME_DIR when that is
+/// set, else ZDUMPD_RUN_DIR. Only the daemon's own user can reach it.
+#define ZDUMPD_RUN_DIR     "/run/zdumpd"
+#define ZDUMPD_USER_DIR    "zdumpd"
+#define ZDUMPD_SOCKET_NAME "socket"
+
+extern int
+zdumpd_socket_path(      /// returns 0 on success, ZD_DIR_PATH if the path
+    char* path,          ///    does not fit in 'size'
+    const size_t size,
+    int* in_default_dir  /// upon successful return, 1 if the path is in
+                         ///    the default directory, 0 if it came from
+                         ///    ZDUMPD_SOCKET. May be NULL.
+                  );
+
+/// Each call makes one connection and one round trip. When no zdumpd is
+/// listening, the calls do the work in-process instead, so they may be
+/// used whether or not the daemon is running.
+
+extern int
+zdumpd_zdump(            /// as zdump(); returns 0 on success, error code
+    char* tzname,        ///    on failure. The daemon refuses with
+                         ///    ZD_BAD_VALUES a start or end whose date
+                         ///    cannot be broken down, other than
+                         ///    ZD_TIME_MIN and ZD_TIME_MAX, and a range of
+                         ///    more than ZDP_MAX_ENTRIES entries
+    const time_t start,
+    const time_t end,
+    int* num_entries,
+    void** return_data
+            );
+
+extern int
+zdumpd_lookup(           /// returns 0 on success, error code on failure,
+                         ///    ZD_BAD_VALUES if a time's date cannot be
+                         ///    broken down (see zdump_gmtime_r)
+    char* tzname,        /// as for zdump()
+    const time_t* times, /// array of 'num_times' times, which is fastest
+    const int num_times, ///    when in ascending order
+    zdumpinfo* results   /// caller's array of 'num_times': the state in
+                         ///    effect at each time; start is the beginning
+                         ///    of its interval
+             );
+
+
+/// the protocol. Client and daemon run on the same host, and zdumpinfo
+/// crosses the socket in its native layout; a request whose info_size
+/// differs from the daemon's is refused with ZD_PROTOCOL.
+#define ZDP_MAGIC     0x5a445031 /// "ZDP1"
+#define ZDP_RANGE     1          /// zdump() of start to end
+#define ZDP_LOOKUP    2          /// num_times int64_t follow the name
+#define ZDP_MAX_NAME  1024
+#define ZDP_MAX_TIMES (1 << 20)
+#define ZDP_MAX_ENTRIES (1 << 20)  /// a longer range is refused, ZD_BAD_VALUES
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	op;
+	uint32_t	info_size;	/// sizeof(zdumpinfo)
+	uint32_t	name_len;	/// name follows, not terminated; 0 for NULL
+	int64_t		start;
+	int64_t		end;
+	uint32_t	num_times;
+	uint32_t	reserved;
+	} zdp_request;
+
+typedef struct {
+	int32_t		result;		/// as zdump()
+	int32_t		num_entries;/// zdumpinfo that follow
+	} zdp_reply;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDCLIENT_H */
@@ -0,0 +1,198 @@
+ /** zdcompare.c                        http://libhdate.sourceforge.net
+ *   zdcompare - which zones, and which ranges of time, differ between
+ *               two parsed zoneinfo trees
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdcompare.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for realloc
+#include <string.h> 	/// for memcmp, strcmp
+#include "zdcompare.h"
+
+/// footer rules repeat every 400 years of the Gregorian calendar
+#define RULE_CYCLE (146097L * 86400L)
+
+/// change_list - the changes found so far
+typedef struct {
+	int			num_entries;
+	int			max_entries;
+	zdchange	*entries;
+	} change_list;
+
+
+static int add_change( change_list* list, const int old_id, const int new_id,
+					   const time_t start, const time_t end )
+{
+	zdchange* new_entries;
+
+	if (list->num_entries == list->max_entries)
+	{
+		list->max_entries = list->max_entries ? list->max_entries * 2 : 16;
+		new_entries = realloc( list->entries, sizeof(zdchange) * list->max_entries );
+		if (new_entries == NULL) return ZD_MALLOC;
+		list->entries = new_entries;
+	}
+	list->entries[list->num_entries].old_id = old_id;
+	list->entries[list->num_entries].new_id = new_id;
+	list->entries[list->num_entries].start = start;
+	list->entries[list->num_entries].end = end;
+	list->num_entries++;
+	return ZD_SUCCESS;
+}
+
+static void first_span( const zdzone* zone, const time_t rules_from, zdspan* span )
+{
+	/// the interval at ZD_TIME_MIN; that of a zone which is all footer
+	/// rule is its interval at rules_from, reaching back
+	if (!zone->timecnt && zone->has_rule && zone->rule.has_dst)
+	{
+		zdzone_span( zone, rules_from, span );
+		span->lo = ZD_TIME_MIN;
+		span->info.start = ZD_TIME_MIN;
+	}
+	else zdzone_span( zone, ZD_TIME_MIN, span );
+}
+
+static int settled( const zdzone* zone, const zdspan* span )
+{
+	/// past the last explicit transition, and any interval it begins
+	return (span->index == zone->timecnt) || (span->hi == ZD_TIME_MAX);
+}
+
+static int same_state( const zdumpinfo* a, const zdumpinfo* b )
+{
+	return (a->utc_offset == b->utc_offset) && (a->save_secs == b->save_secs) &&
+		   !strcmp( a->abbr, b->abbr );
+}
+
+static int same_rules( const zdzone* a, const zdzone* b )
+{
+	if (a->has_rule != b->has_rule) return 0;
+	return !a->has_rule || !memcmp( &a->rule, &b->rule, sizeof(rule_detail) );
+}
+
+static int zone_compare( const zdzone* old_zone, const zdzone* new_zone,
+						 const int old_id, const int new_id, change_list* list )
+{
+	/// walk both zones' intervals together, from one edge of either to
+	/// the next, noting where their states part and meet again
+	struct tm year_start;
+	zdspan a, b;
+	time_t rules_from, cycle_end = ZD_TIME_MAX;
+	time_t t = ZD_TIME_MIN;
+	time_t from = ZD_TIME_MIN;
+	time_t next;
+	int differ = 0, same;
+	int result;
+
+	memset( &year_start, '\0', sizeof(year_start) );
+	year_start.tm_mday = 1;
+	year_start.tm_year = ZD_TIMELINE_FROM - 1900;
+	rules_from = zdump_timegm( &year_start );
+	first_span( old_zone, rules_from, &a );
+	first_span( new_zone, rules_from, &b );
+	while (1)
+	{
+		same = same_state( &a.info, &b.info );
+		if (!same && !differ)
+		{
+			differ = 1;
+			from = t;
+		}
+		else if (same && differ)
+		{
+			differ = 0;
+			result = add_change( list, old_id, new_id, from, t );
+			if (result != ZD_SUCCESS) return result;
+		}
+
+		/// with both zones on their footer rules, a difference recurs
+		/// with the rules; agreement is for ever if the rules are the
+		/// same, else once it has lasted a whole cycle
+		if (settled( old_zone, &a ) && settled( new_zone, &b ))
+		{
+			if (!same || same_rules( old_zone, new_zone )) break;
+			if (cycle_end == ZD_TIME_MAX)
+			{
+				next = t < rules_from ? rules_from : t;
+				if (next < ZD_TIME_MAX - RULE_CYCLE) cycle_end = next + RULE_CYCLE;
+			}
+			else if (t >= cycle_end) break;
+		}
+
+		next = a.hi < b.hi ? a.hi : b.hi;
+		if (next == ZD_TIME_MAX) break;
+		if (a.hi == next) zdzone_next_span( old_zone, &a );
+		if (b.hi == next) zdzone_next_span( new_zone, &b );
+		t = next;
+	}
+	if (differ) return add_change( list, old_id, new_id, from, ZD_TIME_MAX );
+	return ZD_SUCCESS;
+}
+
+
+int zdzone_compare( const zdzone* old_zone, const zdzone* new_zone,
+					int* num_entries, void** return_data )
+{
+	change_list list;
+	int result;
+
+	memset( &list, '\0', sizeof(list) );
+	result = zone_compare( old_zone, new_zone, 0, 0, &list );
+	if (result != ZD_SUCCESS)
+	{
+		free(list.entries);
+		list.entries = NULL;
+		list.num_entries = 0;
+	}
+	*num_entries = list.num_entries;
+	*return_data = list.entries;
+	return result;
+}
+
+int zddb_compare( const zddb* old_db, const zddb* new_db,
+				  int* num_entries, void** return_data )
+{
+	change_list list;
+	int result = ZD_SUCCESS;
+	int i, j;
+
+	memset( &list, '\0', sizeof(list) );
+	for (i=0; (i < new_db->num_zones) && (result == ZD_SUCCESS); i++)
+	{
+		j = zddb_find( old_db, new_db->names[i] );
+		if (j < 0) result = add_change( &list, -1, i, ZD_TIME_MIN, ZD_TIME_MAX );
+		else result = zone_compare( old_db->zones[j], new_db->zones[i], j, i, &list );
+	}
+	for (j=0; (j < old_db->num_zones) && (result == ZD_SUCCESS); j++)
+		if (zddb_find( new_db, old_db->names[j] ) < 0)
+			result = add_change( &list, j, -1, ZD_TIME_MIN, ZD_TIME_MAX );
+
+	if (result != ZD_SUCCESS)
+	{
+		free(list.entries);
+		list.entries = NULL;
+		list.num_entries = 0;
+	}
+	*num_entries = list.num_entries;
+	*return_data = list.entries;
+	return result;
+}
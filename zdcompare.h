@@ -0,0 +1,77 @@
+/** zdcompare.h        http://libhdate.sourceforge.net
+ * Which zones, and which ranges of time, differ between two parsed
+ * zoneinfo trees, eg. before and after a tzdata update.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDCOMPARE_H
+#define ZDCOMPARE_H
+#include "zdump3.h"		/// for zddb, zdzone
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Zones are compared by their intervals, explicit and rule-expanded, not
+/// by their files: two zones differ at a time when their utc_offset,
+/// save_secs or abbreviation differ then. Once both zones are past their
+/// last explicit transition and have the same footer rule, they agree for
+/// ever after; with different rules, the rule-expanded intervals are
+/// compared over a full 400-year cycle, and a difference found there
+/// recurs, so its range is open-ended. Footer rules of zones having no
+/// explicit transitions are compared from ZD_TIMELINE_FROM.
+///
+/// A zdchange tells what a cache, timeline or index built from the old
+/// zone must rebuild: nothing outside its ranges has changed.
+typedef struct {
+	int			old_id;		/// zone id in the old zddb; -1 if the zone is new
+	int			new_id;		/// zone id in the new zddb; -1 if it was removed
+	time_t		start;		/// the zones differ from start
+	time_t		end;		///    to before end; ZD_TIME_MIN and ZD_TIME_MAX
+							///    when unbounded, as for a zone added or removed
+	} zdchange;
+
+extern int
+zdzone_compare(          /// returns 0 on success, error code on failure
+    const zdzone* old_zone,
+    const zdzone* new_zone,
+    int* num_entries,    /// upon successful return, the number of ranges in
+                         ///    which the zones differ; 0 if they never do
+    void** return_data   /// upon successful return, a malloc()ed array of
+                         ///    'num_entries' 'zdchange', their old_id and
+                         ///    new_id 0, in ascending chronological order;
+                         ///    NULL if there are none
+              );
+
+extern int
+zddb_compare(            /// returns 0 on success, error code on failure
+    const zddb* old_db,
+    const zddb* new_db,  /// zones are matched by name
+    int* num_entries,    /// upon successful return, the number of changes;
+                         ///    0 if the trees have the same zones, agreeing
+                         ///    at all times
+    void** return_data   /// upon successful return, a malloc()ed array of
+                         ///    'num_entries' 'zdchange': those of each zone
+                         ///    of new_db in zone id order, each zone's in
+                         ///    chronological order, then the zones removed,
+                         ///    in old zone id order; NULL if there are none
+            );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDCOMPARE_H */
@@ -0,0 +1,333 @@
+ /** zdconv.c                           http://libhdate.sourceforge.net
+ *   zdconv - convert a file of timestamps to local time in a zone
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -O2 -pthread zdconv.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -O2 -pthread zdconv.c -o zdconv -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH \
+ *     ./zdconv [-b] [-f format] [-j threads] [-o output] zonespec input
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>		/// for printf
+#include <stdlib.h>		/// for malloc, free, atoi
+#include <string.h>		/// for memchr, memcpy
+#include <stdint.h>		/// for int64_t
+#include <error.h>		/// for error
+#include <errno.h>		/// for errno
+#include <fcntl.h>		/// for open
+#include <unistd.h>		/// for write, close, sysconf
+#include <pthread.h>	/// for pthread_create
+#include <sys/mman.h>	/// for mmap, madvise
+#include <sys/stat.h>	/// for fstat
+#include <zdump3.h>		/// for zdzone_load, zdcursor
+#include <zdfmt.h>		/// for zdfmt_time
+
+/// The input is mapped, not read, and cut into chunks of about
+/// CHUNK_SIZE bytes, ending at a line (or an 8-byte record). Threads take
+/// chunks in turn, each converting its chunk into a buffer of its own
+/// with a zdcursor, so that runs of nearby timestamps need no search,
+/// and zdfmt. The main thread writes the buffers out in input order.
+/// At most WINDOW chunks per thread are converted ahead of the writing,
+/// bounding memory whatever the size of the input.
+#define CHUNK_SIZE	(8 << 20)
+#define WINDOW		4
+#define LINE_ROOM	256		/// bytes kept free in an output buffer per entry
+#define MAX_ENTRY	(64 << 10)	/// room beyond which an entry cannot be formatted
+
+typedef struct {
+	const char	*in;		/// into the mapped input
+	size_t		in_size;
+	char		*out;		/// malloc()ed
+	size_t		out_size;
+	int			done;
+	} chunk;
+
+typedef struct {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	const zdzone	*zone;
+	const char		*format;
+	int				binary;
+	int				num_chunks;
+	chunk			*chunks;
+	int				next;		/// next chunk to convert
+	int				written;	/// chunks written so far
+	int				window;		/// chunks that may be ahead of 'written'
+	} conversion;
+
+
+static const char* parse_time( const char* in, const char* end, time_t* t )
+{
+	/// a decimal time_t, optionally signed; returns where it ends, or
+	/// NULL if the text is not one
+	unsigned long u = 0;
+	int negative = 0;
+	const char* digits;
+
+	if ((in < end) && ((*in == '-') || (*in == '+'))) negative = *in++ == '-';
+	digits = in;
+	while ((in < end) && (*in >= '0') && (*in <= '9'))
+	{
+		if (u > (unsigned long) LONG_MAX / 10) return NULL;
+		u = (u * 10) + (*in++ - '0');
+	}
+	if ((in == digits) || (u > (unsigned long) LONG_MAX)) return NULL;
+	*t = negative ? -(time_t) u : (time_t) u;
+	return in;
+}
+
+static void convert( const conversion* conv, chunk* ck )
+{
+	const char* in = ck->in;
+	const char* end = ck->in + ck->in_size;
+	const char* line_end;
+	const char* parsed;
+	const zdumpinfo* info;
+	zdcursor cursor;
+	size_t max_out, len;
+	int64_t t64;
+	time_t t = 0;
+
+	zdcursor_init( &cursor, conv->zone );
+	max_out = conv->binary ? (ck->in_size / sizeof(int64_t)) * 40 : ck->in_size * 3;
+	max_out += LINE_ROOM;
+	ck->out = malloc(max_out);
+	if (ck->out == NULL) error(1, errno, "malloc");
+	while (in < end)
+	{
+		if (conv->binary)
+		{
+			memcpy( &t64, in, sizeof(int64_t) );
+			in += sizeof(int64_t);
+			t = (time_t) t64;
+			parsed = in;
+			line_end = in;
+		}
+		else
+		{
+			line_end = memchr( in, '\n', end - in );
+			if (line_end == NULL) line_end = end;
+			parsed = parse_time( in, line_end, &t );
+			if ((parsed != NULL) && (parsed < line_end) && (*parsed == '\r')) parsed++;
+		}
+
+		if (max_out - ck->out_size < LINE_ROOM + (line_end - in))
+		{
+			max_out = (max_out * 2) + (line_end - in);
+			ck->out = realloc( ck->out, max_out );
+			if (ck->out == NULL) error(1, errno, "realloc");
+		}
+		if (parsed == line_end)
+		{
+			/// a long format may need more than LINE_ROOM; grow the buffer
+			/// until the entry fits, failing if it never does
+			info = zdcursor_lookup( &cursor, t );
+			while (!(len = zdfmt_time( &ck->out[ck->out_size], max_out - ck->out_size,
+									   conv->format, t, info->utc_offset, info->abbr )))
+			{
+				if (max_out - ck->out_size >= MAX_ENTRY)
+					error(1, 0, "cannot format time %ld as '%s'", (long) t, conv->format);
+				max_out += max_out - ck->out_size;
+				ck->out = realloc( ck->out, max_out );
+				if (ck->out == NULL) error(1, errno, "realloc");
+			}
+		}
+		else
+		{
+			/// lines that are not a time_t are copied as they are, keeping
+			/// output and input in step
+			len = line_end - in;
+			memcpy( &ck->out[ck->out_size], in, len );
+		}
+		ck->out_size += len;
+		ck->out[ck->out_size++] = '\n';
+		in = conv->binary ? in : line_end + 1;
+	}
+}
+
+static void* worker( void* arg )
+{
+	conversion* conv = arg;
+	int i;
+
+	pthread_mutex_lock(&conv->lock);
+	while (conv->next < conv->num_chunks)
+	{
+		if (conv->next >= conv->written + conv->window)
+		{
+			pthread_cond_wait( &conv->cond, &conv->lock );
+			continue;
+		}
+		i = conv->next++;
+		pthread_mutex_unlock(&conv->lock);
+		convert( conv, &conv->chunks[i] );
+		pthread_mutex_lock(&conv->lock);
+		conv->chunks[i].done = 1;
+		pthread_cond_broadcast(&conv->cond);
+	}
+	pthread_mutex_unlock(&conv->lock);
+	return NULL;
+}
+
+static int cut_chunks( conversion* conv, const char* in, size_t size )
+{
+	/// chunks end at a newline, or at a whole record
+	const char* end = in + size;
+	const char* cut;
+	int max_chunks = (size / CHUNK_SIZE) + 2;
+
+	conv->chunks = calloc( max_chunks, sizeof(chunk) );
+	if (conv->chunks == NULL) error(1, errno, "calloc");
+	while (in < end)
+	{
+		cut = (size_t) (end - in) > CHUNK_SIZE ? in + CHUNK_SIZE : end;
+		if (cut < end)
+		{
+			if (conv->binary) cut = in + CHUNK_SIZE - (CHUNK_SIZE % sizeof(int64_t));
+			else
+			{
+				cut = memchr( cut, '\n', end - cut );
+				cut = cut != NULL ? cut + 1 : end;
+			}
+		}
+		conv->chunks[conv->num_chunks].in = in;
+		conv->chunks[conv->num_chunks].in_size = cut - in;
+		conv->num_chunks++;
+		in = cut;
+	}
+	return conv->num_chunks;
+}
+
+static void write_full( const int fd, const char* buffer, size_t len )
+{
+	ssize_t done;
+
+	while (len)
+	{
+		done = write( fd, buffer, len );
+		if ((done < 0) && (errno == EINTR)) continue;
+		if (done <= 0) error(1, errno, "write");
+		buffer += done;
+		len -= done;
+	}
+}
+
+
+int main (int argc, char *argv[])
+{
+	conversion conv;
+	zdzone* zone;
+	struct stat st;
+	const char* output = NULL;
+	pthread_t* threads;
+	char* map = NULL;
+	size_t size;
+	long num_threads;
+	int in_fd, out_fd = STDOUT_FILENO;
+	int opt, result;
+	int i;
+
+	memset( &conv, '\0', sizeof(conv) );
+	conv.format = ZDFMT_ISO8601;
+	num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt( argc, argv, "bf:j:o:" )) != -1)
+	{
+		switch (opt)
+		{
+		case 'b': conv.binary = 1; break;
+		case 'f': conv.format = optarg; break;
+		case 'j': num_threads = atol(optarg); break;
+		case 'o': output = optarg; break;
+		default:  argc = 0; break;
+		}
+	}
+	if (argc - optind != 2)
+	{
+		printf("\
+zdconv: convert a file of timestamps to local time in a zone\n\
+usage: ./zdconv [-b] [-f format] [-j threads] [-o output] continent/city input\n\
+       input   one time_t per line, or with -b, native int64 time_t's\n\
+       format  as for zdfmt, default \"%s\"\n\
+       threads default, the number of processors\n\
+       output  default, standard output; one line per timestamp, lines\n\
+               of text input that are not a time_t being copied as-is\n",
+			   ZDFMT_ISO8601);
+		exit(0);
+	}
+	if (num_threads < 1) num_threads = 1;
+
+	result = zdzone_load( argv[optind], &zone );
+	if (result != ZD_SUCCESS) error(1, 0, "zone %s: error %d", argv[optind], result);
+	conv.zone = zone;
+	in_fd = open( argv[optind+1], O_RDONLY );
+	if (in_fd < 0) error(1, errno, "%s", argv[optind+1]);
+	if (fstat( in_fd, &st )) error(1, errno, "%s", argv[optind+1]);
+	size = st.st_size;
+	if (conv.binary && (size % sizeof(int64_t)))
+	{
+		error(0, 0, "%s: ignoring %zu trailing bytes", argv[optind+1], size % sizeof(int64_t));
+		size -= size % sizeof(int64_t);
+	}
+	if (size)
+	{
+		map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, in_fd, 0 );
+		if (map == MAP_FAILED) error(1, errno, "mmap %s", argv[optind+1]);
+		madvise( map, size, MADV_SEQUENTIAL );
+	}
+	if (output != NULL)
+	{
+		out_fd = open( output, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+		if (out_fd < 0) error(1, errno, "%s", output);
+	}
+
+	cut_chunks( &conv, map, size );
+	conv.window = num_threads * WINDOW;
+	pthread_mutex_init( &conv.lock, NULL );
+	pthread_cond_init( &conv.cond, NULL );
+	threads = malloc( sizeof(pthread_t) * num_threads );
+	if (threads == NULL) error(1, errno, "malloc");
+	for (i=0; i<num_threads; i++)
+		if (pthread_create( &threads[i], NULL, worker, &conv ))
+			error(1, 0, "pthread_create");
+
+	/// write each chunk as soon as it and all before it are converted
+	for (i=0; i<conv.num_chunks; i++)
+	{
+		pthread_mutex_lock(&conv.lock);
+		while (!conv.chunks[i].done) pthread_cond_wait( &conv.cond, &conv.lock );
+		pthread_mutex_unlock(&conv.lock);
+		write_full( out_fd, conv.chunks[i].out, conv.chunks[i].out_size );
+		free(conv.chunks[i].out);
+		conv.chunks[i].out = NULL;
+		pthread_mutex_lock(&conv.lock);
+		conv.written++;
+		pthread_cond_broadcast(&conv.cond);
+		pthread_mutex_unlock(&conv.lock);
+	}
+	for (i=0; i<num_threads; i++) pthread_join( threads[i], NULL );
+
+	if ((out_fd != STDOUT_FILENO) && close(out_fd)) error(1, errno, "%s", output);
+	if (map != NULL) munmap( map, size );
+	close(in_fd);
+	free(threads);
+	free(conv.chunks);
+	zdzone_free(zone);
+	exit(0);
+}
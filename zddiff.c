@@ -0,0 +1,151 @@
+ /** zddiff.c                           http://libhdate.sourceforge.net
+ *   zddiff - which zones, and which ranges of time, differ between two
+ *            zoneinfo directories
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -O2 zddiff.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -O2 zddiff.c -o zddiff -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH \
+ *     ./zddiff [-n] [-t] old_tzdir new_tzdir
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>		/// for printf
+#include <stdlib.h>		/// for free
+#include <unistd.h>		/// for getopt
+#include <sys/stat.h>	/// for stat
+#include <zdump3.h>		/// for zddb_load
+#include <zdfmt.h>		/// for zdfmt_time
+#include <zdcompare.h>	/// for zddb_compare
+
+/// as diff(1): 0 when the trees agree, 1 when they differ, 2 on trouble
+#define EXIT_SAME    0
+#define EXIT_DIFFER  1
+#define EXIT_TROUBLE 2
+
+
+static const char* show_time( char* buffer, const size_t size, const time_t t,
+							  const int numeric )
+{
+	/// '-' for an unbounded end
+	if ((t == ZD_TIME_MIN) || (t == ZD_TIME_MAX)) return "-";
+	if (numeric) snprintf( buffer, size, "%ld", (long) t );
+	else zdfmt_time( buffer, size, "%Y-%m-%dT%H:%M:%SZ", t, 0, NULL );
+	return buffer;
+}
+
+static zddb* load( const char* tzdir )
+{
+	struct stat dir_status;
+	zddb* db;
+	int result;
+
+	if (stat( tzdir, &dir_status ) || !S_ISDIR(dir_status.st_mode))
+	{
+		fprintf(stderr, "zddiff: %s is not a directory\n", tzdir);
+		exit(EXIT_TROUBLE);
+	}
+	result = zddb_load( tzdir, &db );
+	if (result != ZD_SUCCESS)
+	{
+		fprintf(stderr, "zddiff: error %d loading %s\n", result, tzdir);
+		exit(EXIT_TROUBLE);
+	}
+	return db;
+}
+
+
+int main (int argc, char *argv[])
+{
+	zddb* old_db;
+	zddb* new_db;
+	zdchange* changes;
+	void* data = NULL;
+	const char* name;
+	const char* status;
+	char start[32], end[32];
+	int names_only = 0;
+	int numeric = 0;
+	int num_entries;
+	int opt, result;
+	int i;
+
+	while ((opt = getopt( argc, argv, "nt" )) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': names_only = 1; break;
+		case 't': numeric = 1; break;
+		default:  argc = 0; break;
+		}
+	}
+	if (argc - optind != 2)
+	{
+		printf("\
+zddiff: which zones, and which ranges of time, differ between two\n\
+        zoneinfo directories, eg. before and after a tzdata update\n\
+usage: ./zddiff [-n] [-t] old_tzdir new_tzdir\n\
+       writes a line per range of time in which a zone's local time\n\
+       differs, as: changed zone start end (UTC, '-' when unbounded),\n\
+       and a line per zone added or removed\n\
+       -n  only the names of the zones changed, added or removed\n\
+       -t  times as time_t\n\
+       exit status is 0 if the trees agree, 1 if they differ, 2 on error\n");
+		exit(EXIT_SAME);
+	}
+
+	old_db = load( argv[optind] );
+	new_db = load( argv[optind+1] );
+	result = zddb_compare( old_db, new_db, &num_entries, &data );
+	if (result != ZD_SUCCESS)
+	{
+		fprintf(stderr, "zddiff: error %d\n", result);
+		exit(EXIT_TROUBLE);
+	}
+	changes = data;
+	for (i=0; i<num_entries; i++)
+	{
+		if (changes[i].new_id < 0)
+		{
+			name = old_db->names[ changes[i].old_id ];
+			status = "removed";
+		}
+		else
+		{
+			name = new_db->names[ changes[i].new_id ];
+			status = changes[i].old_id < 0 ? "added" : "changed";
+		}
+		if (names_only)
+		{
+			/// a zone's ranges are consecutive
+			if (!i || (changes[i].old_id != changes[i-1].old_id) ||
+				(changes[i].new_id != changes[i-1].new_id))
+				printf("%s\n", name);
+		}
+		else if ((changes[i].old_id < 0) || (changes[i].new_id < 0))
+			printf("%-8s %s\n", status, name);
+		else
+			printf("%-8s %s %s %s\n", status, name,
+				   show_time( start, sizeof(start), changes[i].start, numeric ),
+				   show_time( end, sizeof(end), changes[i].end, numeric ));
+	}
+	free(data);
+	zddb_free(old_db);
+	zddb_free(new_db);
+	exit(num_entries ? EXIT_DIFFER : EXIT_SAME);
+}
@@ -0,0 +1,281 @@
+ /** zdfmt.c                            http://libhdate.sourceforge.net
+ *   zdfmt - format times and zdump() results into caller buffers
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdfmt.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc
+#include <string.h> 	/// for memcpy
+#include "zdfmt.h"
+
+/// every conversion expands to at most this many characters
+/// (%c with an 11 character year is the longest)
+#define MAX_CONVERSION_SIZE 32
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char day_names[7][10] = { "Sunday", "Monday", "Tuesday",
+	"Wednesday", "Thursday", "Friday", "Saturday" };
+static const char month_names[12][10] = { "January", "February", "March",
+	"April", "May", "June", "July", "August", "September", "October",
+	"November", "December" };
+
+
+static char* put_2( char* out, const int value )
+{
+	memcpy( out, &digit_pairs[ 2 * value ], 2 );
+	return out + 2;
+}
+
+static char* put_long( char* out, long value, int width )
+{
+	/// decimal, zero-padded to 'width' digits, two digits at a time
+	char digits[24];
+	char* next = &digits[24];
+	unsigned long u = value < 0 ? 0UL - (unsigned long) value : (unsigned long) value;
+
+	while (u >= 100)
+	{
+		next -= 2;
+		memcpy( next, &digit_pairs[ 2 * (u % 100) ], 2 );
+		u /= 100;
+	}
+	if (u >= 10)
+	{
+		next -= 2;
+		memcpy( next, &digit_pairs[ 2 * u ], 2 );
+	}
+	else *--next = '0' + u;
+	while (&digits[24] - next < width) *--next = '0';
+	if (value < 0) *out++ = '-';
+	memcpy( out, next, &digits[24] - next );
+	return out + (&digits[24] - next);
+}
+
+static char* put_str( char* out, const char* str, size_t max )
+{
+	while (*str && max--) *out++ = *str++;
+	return out;
+}
+
+static char* put_offset( char* out, const int utc_offset, const int colon )
+{
+	int secs = utc_offset < 0 ? -utc_offset : utc_offset;
+
+	*out++ = utc_offset < 0 ? '-' : '+';
+	out = put_2( out, (secs / 3600) % 100 );
+	if (colon) *out++ = ':';
+	return put_2( out, (secs / 60) % 60 );
+}
+
+static size_t format_bound( const char* format )
+{
+	size_t bound = 0;
+
+	for (; *format; format++)
+	{
+		if ((*format == '%') && format[1])
+		{
+			format++;
+			if ((*format == ':') && format[1]) format++;
+			bound += MAX_CONVERSION_SIZE;
+		}
+		else bound++;
+	}
+	return bound;
+}
+
+static char* render( char* out, const char* format, const struct tm* tm,
+					 const time_t t, const int utc_offset, const char* abbr )
+{
+	/// 'out' has room for format_bound(format) characters
+	int hour12;
+
+	for (; *format; format++)
+	{
+		if ((*format != '%') || !format[1])
+		{
+			*out++ = *format;
+			continue;
+		}
+		format++;
+		switch (*format)
+		{
+		case 'Y': out = put_long( out, tm->tm_year + 1900L, 4 ); break;
+		case 'y': out = put_2( out, ((tm->tm_year % 100) + 100) % 100 ); break;
+		case 'm': out = put_2( out, tm->tm_mon + 1 ); break;
+		case 'd': out = put_2( out, tm->tm_mday ); break;
+		case 'e':
+			if (tm->tm_mday < 10)
+			{
+				*out++ = ' ';
+				*out++ = '0' + tm->tm_mday;
+			}
+			else out = put_2( out, tm->tm_mday );
+			break;
+		case 'H': out = put_2( out, tm->tm_hour ); break;
+		case 'I':
+			hour12 = tm->tm_hour % 12;
+			out = put_2( out, hour12 ? hour12 : 12 );
+			break;
+		case 'p': out = put_str( out, tm->tm_hour < 12 ? "AM" : "PM", 2 ); break;
+		case 'M': out = put_2( out, tm->tm_min ); break;
+		case 'S': out = put_2( out, tm->tm_sec ); break;
+		case 'j': out = put_long( out, tm->tm_yday + 1, 3 ); break;
+		case 'a': out = put_str( out, day_names[tm->tm_wday], 3 ); break;
+		case 'A': out = put_str( out, day_names[tm->tm_wday], 9 ); break;
+		case 'b': out = put_str( out, month_names[tm->tm_mon], 3 ); break;
+		case 'B': out = put_str( out, month_names[tm->tm_mon], 9 ); break;
+		case 'z': out = put_offset( out, utc_offset, 0 ); break;
+		case ':':
+			if (format[1] == 'z')
+			{
+				format++;
+				out = put_offset( out, utc_offset, 1 );
+			}
+			else
+			{
+				*out++ = '%';
+				*out++ = ':';
+			}
+			break;
+		case 'Z': if (abbr != NULL) out = put_str( out, abbr, MAX_TZ_ABBR_SIZE ); break;
+		case 's': out = put_long( out, t, 1 ); break;
+		case 'F':
+			out = put_long( out, tm->tm_year + 1900L, 4 );
+			*out++ = '-';
+			out = put_2( out, tm->tm_mon + 1 );
+			*out++ = '-';
+			out = put_2( out, tm->tm_mday );
+			break;
+		case 'D':
+			out = put_2( out, tm->tm_mon + 1 );
+			*out++ = '/';
+			out = put_2( out, tm->tm_mday );
+			*out++ = '/';
+			out = put_2( out, ((tm->tm_year % 100) + 100) % 100 );
+			break;
+		case 'T':
+			out = put_2( out, tm->tm_hour );
+			*out++ = ':';
+			out = put_2( out, tm->tm_min );
+			*out++ = ':';
+			out = put_2( out, tm->tm_sec );
+			break;
+		case 'c':
+			out = render( out, "%a %b %e %T %Y", tm, t, utc_offset, abbr );
+			break;
+		case 'n': *out++ = '\n'; break;
+		case 't': *out++ = '\t'; break;
+		case '%': *out++ = '%'; break;
+		default:
+			*out++ = '%';
+			*out++ = *format;
+			break;
+		}
+	}
+	return out;
+}
+
+
+static struct tm* local_tm( const time_t t, const int utc_offset, struct tm* tm )
+{
+	/// the broken-down local time, or NULL if it is beyond time_t
+	if ((utc_offset > 0) ? (t > ZD_TIME_MAX - utc_offset) : (t < ZD_TIME_MIN - utc_offset))
+		return NULL;
+	return zdump_gmtime_r( t + utc_offset, tm );
+}
+
+
+size_t zdfmt_time( char* buffer, const size_t size, const char* format,
+				   const time_t t, const int utc_offset, const char* abbr )
+{
+	struct tm tm;
+	char  local_buffer[256];
+	char* out_buffer = buffer;
+	size_t bound = format_bound(format);
+	size_t length;
+
+	if (local_tm( t, utc_offset, &tm ) == NULL) return 0;
+	/// render directly when the caller's buffer is surely large enough
+	if (bound >= size)
+	{
+		if (bound < sizeof(local_buffer)) out_buffer = local_buffer;
+		else out_buffer = malloc( bound + 1 );
+		if (out_buffer == NULL) return 0;
+	}
+	length = render( out_buffer, format, &tm, t, utc_offset, abbr ) - out_buffer;
+	out_buffer[length] = '\0';
+	if (out_buffer != buffer)
+	{
+		if (length < size) memcpy( buffer, out_buffer, length + 1 );
+		else length = 0;
+		if (out_buffer != local_buffer) free(out_buffer);
+	}
+	return length;
+}
+
+size_t zdfmt_entry( char* buffer, const size_t size, const char* format,
+					const zdumpinfo* entry )
+{
+	return zdfmt_time( buffer, size, format, entry->start, entry->utc_offset, entry->abbr );
+}
+
+int zdfmt_batch( const char* format, const zdumpinfo* entries, const int num_entries,
+				 char** return_data, size_t* length )
+{
+	struct tm tm;
+	size_t bound = format_bound(format) + 1;	/// and the newline
+	char* out;
+	int i;
+
+	*length = 0;
+	*return_data = NULL;
+	if (num_entries < 0) return ZD_BAD_VALUES;
+	*return_data = malloc( (bound * num_entries) + 1 );
+	if (*return_data == NULL) return ZD_MALLOC;
+	out = *return_data;
+	for (i=0; i<num_entries; i++)
+	{
+		if (local_tm( entries[i].start, entries[i].utc_offset, &tm ) == NULL)
+		{
+			free(*return_data);
+			*return_data = NULL;
+			return ZD_BAD_VALUES;
+		}
+		out = render( out, format, &tm, entries[i].start, entries[i].utc_offset,
+					  entries[i].abbr );
+		*out++ = '\n';
+	}
+	*out = '\0';
+	*length = out - *return_data;
+	return ZD_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/** zdfmt.h             http://libhdate.sourceforge.net
+ * Format times and zdump() results without locale or TZ lookups.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDFMT_H
+#define ZDFMT_H
+#include <stddef.h>		/// for size_t
+#include "zdump3.h"		/// for zdumpinfo
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// format strings are a subset of strftime(3), always in the C locale:
+///    %a %A %b %B %c %d %D %e %F %H %I %j %m %M %n %p %s %S %t %T
+///    %y %Y %z %:z %Z %%
+/// %z and %:z are the utc_offset (+hhmm, +hh:mm), %Z the abbreviation and
+/// %s the time_t being formatted. Other conversions are copied as-is.
+#define ZDFMT_ISO8601  "%Y-%m-%dT%H:%M:%S%:z"
+#define ZDFMT_ASCTIME  "%c"    /// as asctime(), without its newline
+
+
+extern size_t
+zdfmt_time(              /// returns number of characters written, not
+                         ///    counting the '\0', or 0 if 'size' was too
+                         ///    small (as strftime), or if the local time
+                         ///    is beyond time_t (eg. for ZD_TIME_MIN)
+    char* buffer,        /// caller's buffer, of 'size' characters
+    const size_t size,
+    const char* format,
+    const time_t t,      /// seconds from epoch
+    const int utc_offset,/// in seconds, east of UTC
+    const char* abbr     /// for %Z, may be NULL
+          );
+
+extern size_t
+zdfmt_entry(             /// as zdfmt_time, for the local time at which a
+    char* buffer,        ///    zdump() entry takes effect
+    const size_t size,
+    const char* format,
+    const zdumpinfo* entry
+           );
+
+extern int
+zdfmt_batch(             /// returns 0 on success, error code on failure,
+                         ///    ZD_BAD_VALUES if an entry's local time is
+                         ///    beyond what zdfmt_time can format
+    const char* format,
+    const zdumpinfo* entries, /// array of 'num_entries', eg. from zdump()
+    const int num_entries,
+    char** return_data,  /// upon successful return, a malloc()ed buffer of
+                         ///    every entry formatted, each followed by a
+                         ///    newline, and terminated with '\0'. The caller
+                         ///    must free() it. Returns NULL on failure.
+    size_t* length       /// upon successful return, strlen(*return_data)
+           );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDFMT_H */
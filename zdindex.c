@@ -0,0 +1,467 @@
+ /** zdindex.c                          http://libhdate.sourceforge.net
+ *   zdindex - which zones have an offset, or are in DST, at a time
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdindex.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc, qsort
+#include <string.h> 	/// for memcpy
+#include "zdindex.h"
+
+/// zdrange - an interval [lo, hi) of one zone
+typedef struct {
+	time_t	lo;
+	time_t	hi;
+	} zdrange;
+
+/// zdrange_list - one zone's sorted intervals having one utc_offset
+/// (or, in the dst lists, observing DST)
+typedef struct {
+	int		utc_offset;
+	int		zone_id;
+	int		num_ranges;
+	zdrange	*ranges;	/// points into the zone's pool
+	} zdrange_list;
+
+/// zdindex_zone - everything the index holds for one zone
+typedef struct {
+	zdrange		*pool;
+	int			num_lists;
+	zdrange_list *lists;	/// copied into the index's sorted lists
+	int			has_dst;
+	zdrange_list dst;
+	int			num_transitions;
+	zdmultiinfo	*transitions;
+	} zdindex_zone;
+
+struct zdindex {
+	time_t		start;
+	time_t		end;
+	int			num_zones;
+	zdindex_zone *zones;	/// [num_zones]
+	int			num_lists;
+	zdrange_list *lists;	/// by utc_offset, then zone_id
+	int			num_dst;
+	zdrange_list *dst;		/// by zone_id
+	int			num_transitions;
+	zdmultiinfo	*transitions;	/// by start, then zone_id
+	};
+
+/// an interval record while a zone is being indexed
+typedef struct {
+	int		utc_offset;
+	int		is_dst;
+	zdrange	range;
+	} zdrecord;
+
+
+static int record_compare( const void* a, const void* b )
+{
+	const zdrecord* ra = a;
+	const zdrecord* rb = b;
+
+	if (ra->utc_offset != rb->utc_offset) return ra->utc_offset < rb->utc_offset ? -1 : 1;
+	if (ra->range.lo != rb->range.lo) return ra->range.lo < rb->range.lo ? -1 : 1;
+	return 0;
+}
+
+static int list_compare( const void* a, const void* b )
+{
+	const zdrange_list* la = a;
+	const zdrange_list* lb = b;
+
+	if (la->utc_offset != lb->utc_offset) return la->utc_offset < lb->utc_offset ? -1 : 1;
+	return la->zone_id - lb->zone_id;
+}
+
+static int transition_compare( const void* a, const void* b )
+{
+	const zdmultiinfo* ta = a;
+	const zdmultiinfo* tb = b;
+
+	if (ta->info.start != tb->info.start) return ta->info.start < tb->info.start ? -1 : 1;
+	return ta->zone_id - tb->zone_id;
+}
+
+static void zone_free( zdindex_zone* iz )
+{
+	free(iz->pool);
+	free(iz->lists);
+	free(iz->transitions);
+	memset( iz, '\0', sizeof(zdindex_zone) );
+}
+
+static int zone_build( const zdindex* index, const zdzone* zone, const int zone_id,
+					   zdindex_zone* iz )
+{
+	zditer iter;
+	zdumpinfo entry;
+	zdrecord* records = NULL;
+	zdrecord* new_records;
+	zdmultiinfo* new_transitions;
+	int num_records = 0;
+	int max_records = 0;
+	int num_dst = 0;
+	zdrange* next;
+	time_t hi = index->end < ZD_TIME_MAX ? index->end + 1 : ZD_TIME_MAX;
+	int i;
+
+	memset( iz, '\0', sizeof(zdindex_zone) );
+	zditer_init( &iter, zone, index->start, index->end );
+	while (zditer_next( &iter, &entry ))
+	{
+		if (num_records == max_records)
+		{
+			max_records = max_records ? max_records * 2 : 16;
+			new_records = realloc( records, sizeof(zdrecord) * max_records );
+			if (new_records == NULL) goto failure;
+			records = new_records;
+			new_transitions = realloc( iz->transitions, sizeof(zdmultiinfo) * max_records );
+			if (new_transitions == NULL) goto failure;
+			iz->transitions = new_transitions;
+		}
+		if (num_records) records[num_records-1].range.hi = entry.start;
+		records[num_records].utc_offset = entry.utc_offset;
+		records[num_records].is_dst = entry.save_secs != 0;
+		records[num_records].range.lo = entry.start;
+		records[num_records].range.hi = hi;
+		if (num_records)
+		{
+			iz->transitions[iz->num_transitions].zone_id = zone_id;
+			iz->transitions[iz->num_transitions].info = entry;
+			iz->num_transitions++;
+		}
+		num_records++;
+		num_dst += records[num_records-1].is_dst;
+	}
+
+	/// the pool holds the DST ranges first, then the ranges by offset
+	iz->pool = malloc( sizeof(zdrange) * (num_records + num_dst + 1) );
+	iz->lists = malloc( sizeof(zdrange_list) * (num_records + 1) );
+	if ((iz->pool == NULL) || (iz->lists == NULL)) goto failure;
+	next = iz->pool;
+	iz->dst.zone_id = zone_id;
+	iz->dst.ranges = next;
+	for (i=0; i<num_records; i++) if (records[i].is_dst)
+	{
+		if (iz->dst.num_ranges && (next[-1].hi == records[i].range.lo))
+			next[-1].hi = records[i].range.hi;
+		else
+		{
+			*next++ = records[i].range;
+			iz->dst.num_ranges++;
+		}
+	}
+	iz->has_dst = iz->dst.num_ranges > 0;
+
+	qsort( records, num_records, sizeof(zdrecord), record_compare );
+	for (i=0; i<num_records; i++)
+	{
+		if (!i || (records[i].utc_offset != records[i-1].utc_offset))
+		{
+			iz->lists[iz->num_lists].utc_offset = records[i].utc_offset;
+			iz->lists[iz->num_lists].zone_id = zone_id;
+			iz->lists[iz->num_lists].num_ranges = 0;
+			iz->lists[iz->num_lists].ranges = next;
+			iz->num_lists++;
+		}
+		else if (next[-1].hi == records[i].range.lo)
+		{
+			next[-1].hi = records[i].range.hi;
+			continue;
+		}
+		*next++ = records[i].range;
+		iz->lists[iz->num_lists-1].num_ranges++;
+	}
+	free(records);
+	return ZD_SUCCESS;
+
+failure:
+	free(records);
+	zone_free(iz);
+	return ZD_MALLOC;
+}
+
+static int lists_gather( zdindex* index )
+{
+	/// rebuild the index's sorted lists, and its merged transitions,
+	/// from those of its zones
+	zdrange_list* lists;
+	zdrange_list* dst;
+	zdmultiinfo* transitions;
+	int num_lists = 0;
+	int num_transitions = 0;
+	int i;
+
+	for (i=0; i<index->num_zones; i++)
+	{
+		num_lists += index->zones[i].num_lists;
+		num_transitions += index->zones[i].num_transitions;
+	}
+	lists = malloc( sizeof(zdrange_list) * (num_lists + 1) );
+	dst = malloc( sizeof(zdrange_list) * (index->num_zones + 1) );
+	transitions = malloc( sizeof(zdmultiinfo) * (num_transitions + 1) );
+	if ((lists == NULL) || (dst == NULL) || (transitions == NULL))
+	{
+		free(lists);
+		free(dst);
+		free(transitions);
+		return ZD_MALLOC;
+	}
+	free(index->lists);
+	free(index->dst);
+	free(index->transitions);
+	index->lists = lists;
+	index->dst = dst;
+	index->transitions = transitions;
+	index->num_lists = 0;
+	index->num_dst = 0;
+	index->num_transitions = 0;
+	for (i=0; i<index->num_zones; i++)
+	{
+		memcpy( &lists[index->num_lists], index->zones[i].lists,
+				sizeof(zdrange_list) * index->zones[i].num_lists );
+		index->num_lists += index->zones[i].num_lists;
+		if (index->zones[i].has_dst) dst[index->num_dst++] = index->zones[i].dst;
+		memcpy( &transitions[index->num_transitions], index->zones[i].transitions,
+				sizeof(zdmultiinfo) * index->zones[i].num_transitions );
+		index->num_transitions += index->zones[i].num_transitions;
+	}
+	qsort( lists, index->num_lists, sizeof(zdrange_list), list_compare );
+	qsort( transitions, index->num_transitions, sizeof(zdmultiinfo), transition_compare );
+	return ZD_SUCCESS;
+}
+
+static int lists_merge( zdindex* index, const int zone_id, const zdindex_zone* iz )
+{
+	/// replace zone_id's lists, dst list and transitions in the index's
+	/// sorted arrays with those of iz, each in one merging pass; iz's own
+	/// are already in order
+	const zdindex_zone* old = &index->zones[zone_id];
+	zdrange_list* lists;
+	zdrange_list* dst;
+	zdmultiinfo* transitions;
+	int num_lists, num_dst, num_transitions;
+	int i, j, n;
+
+	lists = malloc( sizeof(zdrange_list) * (index->num_lists - old->num_lists + iz->num_lists + 1) );
+	dst = malloc( sizeof(zdrange_list) * (index->num_dst + 2) );
+	transitions = malloc( sizeof(zdmultiinfo) *
+			(index->num_transitions - old->num_transitions + iz->num_transitions + 1) );
+	if ((lists == NULL) || (dst == NULL) || (transitions == NULL))
+	{
+		free(lists);
+		free(dst);
+		free(transitions);
+		return ZD_MALLOC;
+	}
+
+	for (i=0, j=0, n=0; (i < index->num_lists) || (j < iz->num_lists); )
+	{
+		if ((i < index->num_lists) && (index->lists[i].zone_id == zone_id)) i++;
+		else if ((j < iz->num_lists) && ((i == index->num_lists) ||
+				 (list_compare( &iz->lists[j], &index->lists[i] ) < 0)))
+			lists[n++] = iz->lists[j++];
+		else lists[n++] = index->lists[i++];
+	}
+	num_lists = n;
+
+	for (i=0, n=0; i < index->num_dst; i++)
+	{
+		if (iz->has_dst && (index->dst[i].zone_id > zone_id) &&
+			((n == 0) || (dst[n-1].zone_id < zone_id)))
+			dst[n++] = iz->dst;
+		if (index->dst[i].zone_id != zone_id) dst[n++] = index->dst[i];
+	}
+	if (iz->has_dst && ((n == 0) || (dst[n-1].zone_id < zone_id))) dst[n++] = iz->dst;
+	num_dst = n;
+
+	for (i=0, j=0, n=0; (i < index->num_transitions) || (j < iz->num_transitions); )
+	{
+		if ((i < index->num_transitions) && (index->transitions[i].zone_id == zone_id)) i++;
+		else if ((j < iz->num_transitions) && ((i == index->num_transitions) ||
+				 (transition_compare( &iz->transitions[j], &index->transitions[i] ) < 0)))
+			transitions[n++] = iz->transitions[j++];
+		else transitions[n++] = index->transitions[i++];
+	}
+	num_transitions = n;
+
+	free(index->lists);
+	free(index->dst);
+	free(index->transitions);
+	index->lists = lists;
+	index->num_lists = num_lists;
+	index->dst = dst;
+	index->num_dst = num_dst;
+	index->transitions = transitions;
+	index->num_transitions = num_transitions;
+	return ZD_SUCCESS;
+}
+
+
+int zdindex_build( const zddb* db, const time_t start, const time_t end, zdindex** index )
+{
+	int result = ZD_SUCCESS;
+	int i;
+
+	*index = NULL;
+	if (end < start) return ZD_BAD_VALUES;
+	*index = calloc( 1, sizeof(zdindex) );
+	if (*index == NULL) return ZD_MALLOC;
+	(*index)->start = start;
+	(*index)->end = end;
+	(*index)->zones = calloc( db->num_zones + 1, sizeof(zdindex_zone) );
+	if ((*index)->zones == NULL) result = ZD_MALLOC;
+	for (i=0; (result == ZD_SUCCESS) && (i<db->num_zones); i++)
+	{
+		result = zone_build( *index, db->zones[i], i, &(*index)->zones[i] );
+		(*index)->num_zones++;
+	}
+	if (result == ZD_SUCCESS) result = lists_gather( *index );
+	if (result != ZD_SUCCESS)
+	{
+		zdindex_free(*index);
+		*index = NULL;
+	}
+	return result;
+}
+
+int zdindex_update( zdindex* index, const zddb* db, const int zone_id )
+{
+	/// only the one zone is re-indexed, and merged into the others' lists
+	zdindex_zone iz;
+	zdindex_zone* new_zones;
+	int result;
+
+	if ((zone_id < 0) || (zone_id >= db->num_zones)) return ZD_BAD_VALUES;
+	if (zone_id >= index->num_zones)
+	{
+		new_zones = realloc( index->zones, sizeof(zdindex_zone) * (zone_id + 1) );
+		if (new_zones == NULL) return ZD_MALLOC;
+		memset( &new_zones[index->num_zones], '\0',
+				sizeof(zdindex_zone) * (zone_id + 1 - index->num_zones) );
+		index->zones = new_zones;
+		index->num_zones = zone_id + 1;
+	}
+	result = zone_build( index, db->zones[zone_id], zone_id, &iz );
+	if (result != ZD_SUCCESS) return result;
+	result = lists_merge( index, zone_id, &iz );
+	if (result != ZD_SUCCESS)
+	{
+		zone_free(&iz);
+		return result;
+	}
+	zone_free( &index->zones[zone_id] );
+	index->zones[zone_id] = iz;
+	return ZD_SUCCESS;
+}
+
+void zdindex_free( zdindex* index )
+{
+	int i;
+
+	if (index == NULL) return;
+	for (i=0; i<index->num_zones; i++) zone_free( &index->zones[i] );
+	free(index->zones);
+	free(index->lists);
+	free(index->dst);
+	free(index->transitions);
+	free(index);
+}
+
+
+static int list_contains( const zdrange_list* list, const time_t t )
+{
+	int lo = 0;
+	int hi = list->num_ranges - 1;
+	int mid;
+
+	/// the last range with lo <= t
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo + 1) / 2);
+		if (list->ranges[mid].lo <= t) lo = mid;
+		else hi = mid - 1;
+	}
+	return (list->ranges[lo].lo <= t) && (t < list->ranges[lo].hi);
+}
+
+int zdindex_offset_at( const zdindex* index, const time_t t, const int utc_offset,
+					   int* zone_ids, int* num_found )
+{
+	int lo = 0;
+	int hi = index->num_lists;
+	int mid;
+
+	*num_found = 0;
+	if ((t < index->start) || (t > index->end)) return ZD_BAD_VALUES;
+	/// the first list having utc_offset
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo) / 2);
+		if (index->lists[mid].utc_offset < utc_offset) lo = mid + 1;
+		else hi = mid;
+	}
+	for (; (lo < index->num_lists) && (index->lists[lo].utc_offset == utc_offset); lo++)
+		if (list_contains( &index->lists[lo], t ))
+			zone_ids[(*num_found)++] = index->lists[lo].zone_id;
+	return ZD_SUCCESS;
+}
+
+int zdindex_dst_at( const zdindex* index, const time_t t, int* zone_ids, int* num_found )
+{
+	int i;
+
+	*num_found = 0;
+	if ((t < index->start) || (t > index->end)) return ZD_BAD_VALUES;
+	for (i=0; i<index->num_dst; i++)
+		if (list_contains( &index->dst[i], t ))
+			zone_ids[(*num_found)++] = index->dst[i].zone_id;
+	return ZD_SUCCESS;
+}
+
+int zdindex_transitions( const zdindex* index, const time_t from, const time_t to,
+						 const zdmultiinfo** first, int* num_found )
+{
+	int lo = 0;
+	int hi = index->num_transitions;
+	int mid;
+
+	*first = NULL;
+	*num_found = 0;
+	if ((to < from) || (from < index->start) || (to > index->end)) return ZD_BAD_VALUES;
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo) / 2);
+		if (index->transitions[mid].info.start < from) lo = mid + 1;
+		else hi = mid;
+	}
+	*first = &index->transitions[lo];
+	hi = index->num_transitions;
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo) / 2);
+		if (index->transitions[mid].info.start <= to) lo = mid + 1;
+		else hi = mid;
+	}
+	*num_found = lo - (*first - index->transitions);
+	return ZD_SUCCESS;
+}
@@ -0,0 +1,88 @@
+/** zdindex.h           http://libhdate.sourceforge.net
+ * Inverted index over a zone database: which zones have a given
+ * utc_offset, or are in DST, at a given time, and which zones change
+ * during a given interval.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDINDEX_H
+#define ZDINDEX_H
+#include "zdump3.h"		/// for zddb, zdmultiinfo
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// zdindex - built once over a zddb for the interval start to end.
+/// For each utc_offset, and for DST, each zone's intervals are kept in
+/// sorted lists, so that a query is one binary search per zone having
+/// that offset at some time. All transitions are kept in one array in
+/// chronological order. The index holds no pointers into the database.
+typedef struct zdindex zdindex;
+
+extern int
+zdindex_build(           /// returns 0 on success, error code on failure
+    const zddb* db,
+    const time_t start,  /// interval covered by the index; queries
+    const time_t end,    ///    outside it fail with ZD_BAD_VALUES
+    zdindex** index      /// upon successful return, a malloc()ed index
+                         ///    to be released with zdindex_free()
+             );
+
+extern int
+zdindex_update(          /// after zddb_reload(), re-index that zone only.
+    zdindex* index,      ///    returns 0 on success, error code on failure
+    const zddb* db,
+    const int zone_id
+              );
+
+extern void
+zdindex_free( zdindex* index );
+
+extern int
+zdindex_offset_at(       /// returns 0 on success, error code on failure
+    const zdindex* index,
+    const time_t t,
+    const int utc_offset,/// in seconds, east of UTC
+    int* zone_ids,       /// caller's array, of room for db->num_zones,
+                         ///    filled in ascending zone id order
+    int* num_found
+                 );
+
+extern int
+zdindex_dst_at(          /// as zdindex_offset_at, for zones observing DST
+    const zdindex* index,///    (save_secs != 0) at time t
+    const time_t t,
+    int* zone_ids,
+    int* num_found
+              );
+
+extern int
+zdindex_transitions(     /// returns 0 on success, error code on failure
+    const zdindex* index,
+    const time_t from,   /// transitions with from <= start <= to
+    const time_t to,
+    const zdmultiinfo** first, /// upon successful return, points into the
+                         ///    index at the first such transition; valid
+                         ///    until the index is next updated or freed
+    int* num_found
+                   );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDINDEX_H */
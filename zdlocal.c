@@ -0,0 +1,162 @@
+ /** zdlocal.c                          http://libhdate.sourceforge.net
+ *   zdlocal - the gaps and folds of a zone's local time, indexed
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdlocal.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc, qsort
+#include "zdlocal.h"
+
+/// a local time is within this of the UTC time it names; local times
+/// this close to the end of a timeline may have shifts beyond it
+#define MAX_OFFSET (26L * 3600L)
+
+
+static int shift_before( const void* a, const void* b )
+{
+	const zdshift* x = a;
+	const zdshift* y = b;
+
+	if (x->lo != y->lo) return x->lo < y->lo ? -1 : 1;
+	return x->transition < y->transition ? -1 : x->transition > y->transition;
+}
+
+static int shift_search( const zdlocal* index, const time_t local )
+{
+	/// the last shift beginning at or before local, or -1
+	int lo = 0;
+	int hi = index->num_entries - 1;
+	int mid;
+
+	if ((hi < 0) || (local < index->entries[0].lo)) return -1;
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo + 1) / 2);
+		if (index->entries[mid].lo <= local) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+static int shift_kind( const zdlocal* index, const int pos, const time_t local )
+{
+	if ((pos < 0) || (local >= index->entries[pos].hi)) return ZD_LOCAL_UNIQUE;
+	return index->entries[pos].kind;
+}
+
+
+int zdlocal_build( const zdzone* zone, const long horizon, zdlocal** index )
+{
+	zdtimeline* tl;
+	zdlocal* zl;
+	zdshift* shift;
+	const zdumpinfo* before;
+	const zdumpinfo* after;
+	int result;
+	int i;
+
+	*index = NULL;
+	result = zdtimeline_build( zone, horizon, &tl );
+	if (result != ZD_SUCCESS) return result;
+	zl = calloc( 1, sizeof(zdlocal) );
+	if (zl == NULL) {result= ZD_MALLOC; goto endpoint;};
+	zl->horizon = horizon;
+	zl->begin = tl->begin == ZD_TIME_MIN ? ZD_TIME_MIN : tl->begin + MAX_OFFSET;
+	zl->end = tl->end == ZD_TIME_MAX ? ZD_TIME_MAX : tl->end - MAX_OFFSET;
+	zl->entries = malloc( sizeof(zdshift) * (tl->num_entries + 1) );
+	if (zl->entries == NULL) {result= ZD_MALLOC; goto endpoint;};
+
+	/// each change of utc_offset is a gap or a fold, from the local time
+	/// it would be on the earlier offset to that on the later
+	for (i=1; i<tl->num_entries; i++)
+	{
+		before = &tl->entries[i-1];
+		after = &tl->entries[i];
+		if (after->utc_offset == before->utc_offset) continue;
+		shift = &zl->entries[ zl->num_entries++ ];
+		shift->transition = after->start;
+		shift->offset_before = before->utc_offset;
+		shift->offset_after = after->utc_offset;
+		if (after->utc_offset > before->utc_offset)
+		{
+			shift->kind = ZD_LOCAL_GAP;
+			shift->lo = after->start + before->utc_offset;
+			shift->hi = after->start + after->utc_offset;
+		}
+		else
+		{
+			shift->kind = ZD_LOCAL_FOLD;
+			shift->lo = after->start + after->utc_offset;
+			shift->hi = after->start + before->utc_offset;
+		}
+	}
+	/// offsets of neighbouring transitions may reorder their local times
+	qsort( zl->entries, zl->num_entries, sizeof(zdshift), shift_before );
+	*index = zl;
+	zl = NULL;
+
+/// cleanup and exit
+endpoint:
+	zdlocal_free(zl);
+	zdtimeline_free(tl);
+	return result;
+}
+
+void zdlocal_free( zdlocal* index )
+{
+	if (index == NULL) return;
+	free(index->entries);
+	free(index);
+}
+
+int zdlocal_classify( const zdlocal* index, const time_t local, int* kind,
+					  const zdshift** shift )
+{
+	int pos;
+
+	*kind = ZD_LOCAL_UNIQUE;
+	*shift = NULL;
+	if ((local < index->begin) || (local >= index->end)) return ZD_HORIZON;
+	pos = shift_search( index, local );
+	*kind = shift_kind( index, pos, local );
+	if (*kind != ZD_LOCAL_UNIQUE) *shift = &index->entries[pos];
+	return ZD_SUCCESS;
+}
+
+int zdlocal_classify_batch( const zdlocal* index, const time_t* locals,
+							const int num_locals, unsigned char* kinds )
+{
+	/// while the times ascend, step forward from the previous shift
+	/// rather than search again
+	int pos = -1;
+	int i;
+
+	for (i=0; i<num_locals; i++)
+	{
+		if ((locals[i] < index->begin) || (locals[i] >= index->end)) return ZD_HORIZON;
+		if (!i || (locals[i] < locals[i-1])) pos = shift_search( index, locals[i] );
+		else
+			while ((pos + 1 < index->num_entries) && (index->entries[pos+1].lo <= locals[i]))
+				pos++;
+		kinds[i] = shift_kind( index, pos, locals[i] );
+	}
+	return ZD_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/** zdlocal.h           http://libhdate.sourceforge.net
+ * Local (wall clock) times that do not exist, or occur twice, in a zone:
+ * its gaps and folds, indexed for classifying local times directly.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDLOCAL_H
+#define ZDLOCAL_H
+#include "zdump3.h"		/// for zdzone
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A local time is given as the seconds from epoch that it would be were
+/// it UTC, eg. zdump_timegm() of its broken-down fields. Each transition
+/// that moves the clock forward leaves a gap, the local times it skips;
+/// one moving it back makes a fold, the local times it repeats. The gaps
+/// and folds of a zone's explicit transitions, and of its footer rule
+/// through a horizon year, are listed once in ascending order, so that
+/// classifying a local time is one binary search, with no conversion to
+/// UTC and back.
+#define ZD_LOCAL_UNIQUE 0	/// occurs once
+#define ZD_LOCAL_GAP    1	/// does not occur: the clock skips it
+#define ZD_LOCAL_FOLD   2	/// occurs twice: the clock repeats it
+
+/// zdshift - one gap or fold, [lo, hi) in local time
+typedef struct {
+	time_t		lo;
+	time_t		hi;
+	time_t		transition;		/// the UTC time of the transition making it
+	int			kind;			/// ZD_LOCAL_GAP or ZD_LOCAL_FOLD
+	int			offset_before;	/// utc_offset before the transition, and
+	int			offset_after;	///    after it; for a fold, lo - offset_after
+								///    is the earlier of a time's two instants
+	} zdshift;
+
+typedef struct {
+	long		horizon;		/// as for zdtimeline_build()
+	time_t		begin;			/// local times covered, from begin
+	time_t		end;			///    to before end (ZD_TIME_MAX for ever)
+	int			num_entries;
+	zdshift		*entries;		/// [num_entries] ascending
+	} zdlocal;
+
+extern int
+zdlocal_build(           /// returns 0 on success, error code on failure
+    const zdzone* zone,  /// not referenced once built
+    const long horizon,  /// year through which to expand the footer rule,
+                         ///    as for zdtimeline_build()
+    zdlocal** index      /// upon successful return, a malloc()ed index
+                         ///    to be released with zdlocal_free()
+             );
+
+extern void
+zdlocal_free( zdlocal* index );
+
+extern int
+zdlocal_classify(        /// returns 0 on success, ZD_HORIZON if 'local'
+    const zdlocal* index,///    is outside begin to end
+    const time_t local,
+    int* kind,           /// upon successful return, a ZD_LOCAL_* value
+    const zdshift** shift /// upon successful return, the gap or fold
+                         ///    containing 'local', or NULL if unique
+                );
+
+extern int
+zdlocal_classify_batch(  /// returns 0 on success, ZD_HORIZON at the first
+    const zdlocal* index,///    time outside begin to end
+    const time_t* locals,/// array of 'num_locals' local times; one binary
+    const int num_locals,///    search serves an ascending run of them
+    unsigned char* kinds /// array of 'num_locals' results, ZD_LOCAL_* values
+                      );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDLOCAL_H */
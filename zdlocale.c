@@ -0,0 +1,345 @@
+ /** zdlocale.c                         http://libhdate.sourceforge.net
+ *   zdlocale - format zdump results in many locales, in one process
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -g -pthread zdlocale.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -pthread zdlocale.c -o zdlocale -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH \
+ *     ./zdlocale [options] zonespec start_time end_time
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>		/// for printf, popen, getline
+#include <stdlib.h>		/// for malloc, free, atol
+#include <string.h>		/// for strchr, memcmp
+#include <error.h>		/// for error
+#include <errno.h>		/// for errno
+#include <unistd.h>		/// for getopt, sysconf
+#include <locale.h>		/// for newlocale, uselocale
+#include <time.h>		/// for strftime, clock_gettime
+#include <pthread.h>	/// for pthread_create
+#include <zdump3.h>		/// for zdump, zdump_gmtime_r
+
+/// Where locale_test.sh runs a command once per locale, each in its own
+/// process, zdlocale calls zdump() once and then formats its results in
+/// every locale from threads of this process, each thread switching
+/// locale with uselocale(). The formatted output of each locale may be
+/// saved to a directory, and a later run compared against it.
+#define DEFAULT_FORMAT "%c %Z"
+#define LINE_SIZE 256
+#define LOCALE_LIST "locale -a"		/// every installed locale
+
+typedef struct {
+	char	*name;
+	char	*output;		/// malloc()ed, each entry's line
+	size_t	length;
+	double	seconds;		/// to format every entry
+	int		missing;		/// newlocale() failed
+	} locale_run;
+
+typedef struct {
+	pthread_mutex_t	lock;
+	int				next;		/// next locale to run
+	int				num_locales;
+	locale_run		*runs;
+	int				num_entries;
+	struct tm		*local;		/// [num_entries] each entry's local time
+	const char		*format;
+	} workload;
+
+
+static double seconds_now( void )
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+static void run_locale( const workload* work, locale_run* run )
+{
+	locale_t loc;
+	char line[LINE_SIZE];
+	size_t len, size;
+	double start;
+	int i;
+
+	loc = newlocale( LC_ALL_MASK, run->name, (locale_t) 0 );
+	if (loc == (locale_t) 0)
+	{
+		run->missing = 1;
+		return;
+	}
+	size = (size_t) work->num_entries * 64 + 1;
+	run->output = malloc(size);
+	if (run->output == NULL) error(1, errno, "malloc");
+	uselocale(loc);
+	start = seconds_now();
+	for (i=0; i<work->num_entries; i++)
+	{
+		len = strftime( line, LINE_SIZE - 1, work->format, &work->local[i] );
+		line[len++] = '\n';
+		if (run->length + len >= size)
+		{
+			size = (size * 2) + len;
+			run->output = realloc( run->output, size );
+			if (run->output == NULL) error(1, errno, "realloc");
+		}
+		memcpy( &run->output[run->length], line, len );
+		run->length += len;
+	}
+	run->seconds = seconds_now() - start;
+	uselocale(LC_GLOBAL_LOCALE);
+	freelocale(loc);
+}
+
+static void* worker( void* arg )
+{
+	workload* work = arg;
+	int i;
+
+	while (1)
+	{
+		pthread_mutex_lock(&work->lock);
+		i = work->next++;
+		pthread_mutex_unlock(&work->lock);
+		if (i >= work->num_locales) return NULL;
+		run_locale( work, &work->runs[i] );
+	}
+}
+
+static int read_locales( FILE* list, locale_run** runs )
+{
+	/// one locale name per line; '#' begins a comment
+	char* line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	int num_locales = 0;
+	int max_locales = 0;
+
+	*runs = NULL;
+	while ((len = getline( &line, &line_size, list )) > 0)
+	{
+		line[strcspn( line, "#\n \t" )] = '\0';
+		if (line[0] == '\0') continue;
+		if (num_locales == max_locales)
+		{
+			max_locales = max_locales ? max_locales * 2 : 256;
+			*runs = realloc( *runs, sizeof(locale_run) * max_locales );
+			if (*runs == NULL) error(1, errno, "realloc");
+		}
+		memset( &(*runs)[num_locales], '\0', sizeof(locale_run) );
+		(*runs)[num_locales].name = strdup(line);
+		if ((*runs)[num_locales].name == NULL) error(1, errno, "strdup");
+		num_locales++;
+	}
+	free(line);
+	return num_locales;
+}
+
+static char* read_saved( const char* dir, const char* name, size_t* length )
+{
+	/// a locale's output from an earlier run, or NULL
+	char path[4096];
+	char* saved;
+	FILE* file;
+	long size;
+
+	snprintf( path, sizeof(path), "%s/%s", dir, name );
+	file = fopen( path, "r" );
+	if (file == NULL) return NULL;
+	fseek( file, 0, SEEK_END );
+	size = ftell(file);
+	rewind(file);
+	saved = malloc( size + 1 );
+	if ((saved != NULL) && (fread( saved, 1, size, file ) != (size_t) size))
+	{
+		free(saved);
+		saved = NULL;
+	}
+	fclose(file);
+	*length = size;
+	return saved;
+}
+
+static int first_difference( const char* a, const size_t a_len,
+							 const char* b, const size_t b_len )
+{
+	/// the line number, from 1, at which two outputs part; 0 if equal
+	size_t i;
+	int line = 1;
+
+	for (i=0; (i < a_len) && (i < b_len) && (a[i] == b[i]); i++)
+		if (a[i] == '\n') line++;
+	return ((i == a_len) && (i == b_len)) ? 0 : line;
+}
+
+static void save_output( const char* dir, const locale_run* run )
+{
+	char path[4096];
+	FILE* file;
+
+	snprintf( path, sizeof(path), "%s/%s", dir, run->name );
+	file = fopen( path, "w" );
+	if ((file == NULL) || (fwrite( run->output, 1, run->length, file ) != run->length))
+		error(1, errno, "writing %s", path);
+	fclose(file);
+}
+
+
+int main (int argc, char *argv[])
+{
+	workload work;
+	zdumpinfo* zd;
+	void* data = NULL;
+	const char* save_dir = NULL;
+	const char* compare_dir = NULL;
+	const char* list_name = NULL;
+	FILE* list;
+	pthread_t* threads;
+	long num_threads;
+	char* saved;
+	size_t saved_len;
+	double start, elapsed, total = 0;
+	int num_changed = 0, num_missing = 0;
+	int line, opt, result;
+	int i;
+
+	memset( &work, '\0', sizeof(work) );
+	work.format = DEFAULT_FORMAT;
+	num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt( argc, argv, "f:j:l:s:c:" )) != -1)
+	{
+		switch (opt)
+		{
+		case 'f': work.format = optarg; break;
+		case 'j': num_threads = atol(optarg); break;
+		case 'l': list_name = optarg; break;
+		case 's': save_dir = optarg; break;
+		case 'c': compare_dir = optarg; break;
+		default:  argc = 0; break;
+		}
+	}
+	if (argc - optind != 3)
+	{
+		printf("\
+zdlocale: format zdump results in many locales, in one process\n\
+usage: ./zdlocale [-f format] [-j threads] [-l locale_file] [-s save_dir]\n\
+                  [-c compare_dir] continent/city time_t time_t\n\
+       format      for strftime(3), default \"%s\"\n\
+       threads     default, the number of processors\n\
+       locale_file locale names, one per line; default, those of '%s'\n\
+       save_dir    write each locale's output to save_dir/<locale>\n\
+       compare_dir report each locale whose output differs from\n\
+                   compare_dir/<locale>, as saved by an earlier run\n",
+			   DEFAULT_FORMAT, LOCALE_LIST);
+		exit(0);
+	}
+	if (num_threads < 1) num_threads = 1;
+
+	result = zdump( argv[optind], atol(argv[optind+1]), atol(argv[optind+2]),
+					&work.num_entries, &data );
+	if (result != ZD_SUCCESS) error(1, 0, "zdump %s: error %d", argv[optind], result);
+	zd = data;
+
+	/// each entry's local time, shared read-only by every locale
+	work.local = malloc( sizeof(struct tm) * work.num_entries );
+	if (work.local == NULL) error(1, errno, "malloc");
+	for (i=0; i<work.num_entries; i++)
+	{
+		zdump_gmtime_r( zd[i].start + zd[i].utc_offset, &work.local[i] );
+		work.local[i].tm_isdst = zd[i].save_secs != 0;
+		work.local[i].tm_gmtoff = zd[i].utc_offset;
+		work.local[i].tm_zone = zd[i].abbr;
+	}
+
+	if (list_name != NULL) list = fopen( list_name, "r" );
+	else list = popen( LOCALE_LIST, "r" );
+	if (list == NULL) error(1, errno, "%s", list_name != NULL ? list_name : LOCALE_LIST);
+	work.num_locales = read_locales( list, &work.runs );
+	if (list_name != NULL) fclose(list);
+	else pclose(list);
+	for (i=0; i<work.num_locales; i++)
+		if (strchr( work.runs[i].name, '/' ) != NULL)
+			error(1, 0, "not a locale name: %s", work.runs[i].name);
+
+	if (num_threads > work.num_locales) num_threads = work.num_locales;
+	threads = malloc( sizeof(pthread_t) * (num_threads + 1) );
+	if (threads == NULL) error(1, errno, "malloc");
+	pthread_mutex_init( &work.lock, NULL );
+	start = seconds_now();
+	for (i=0; i<num_threads; i++)
+		if (pthread_create( &threads[i], NULL, worker, &work ))
+			error(1, 0, "pthread_create");
+	for (i=0; i<num_threads; i++) pthread_join( threads[i], NULL );
+	elapsed = seconds_now() - start;
+
+	printf("zone: %s    entries: %d    format: \"%s\"\n",
+		   argv[optind], work.num_entries, work.format);
+	printf("%-24s %10s %8s  %s\n", "locale", "usec", "bytes", "status");
+	for (i=0; i<work.num_locales; i++)
+	{
+		locale_run* run = &work.runs[i];
+
+		if (run->missing)
+		{
+			num_missing++;
+			printf("%-24s %10s %8s  not installed\n", run->name, "-", "-");
+			continue;
+		}
+		total += run->seconds;
+		printf("%-24s %10.1f %8zu  ", run->name, run->seconds * 1e6, run->length);
+		if (save_dir != NULL) save_output( save_dir, run );
+		if (compare_dir == NULL)
+		{
+			printf("ok\n");
+			continue;
+		}
+		saved = read_saved( compare_dir, run->name, &saved_len );
+		if (saved == NULL)
+		{
+			num_changed++;
+			printf("no saved output\n");
+			continue;
+		}
+		line = first_difference( saved, saved_len, run->output, run->length );
+		if (line)
+		{
+			num_changed++;
+			printf("differs from line %d\n", line);
+		}
+		else printf("same\n");
+		free(saved);
+	}
+	printf("locales: %d    not installed: %d", work.num_locales, num_missing);
+	if (compare_dir != NULL) printf("    differing: %d", num_changed);
+	printf("\nthreads: %ld    wall usec: %.1f    sum of locale usec: %.1f\n",
+		   num_threads, elapsed * 1e6, total * 1e6);
+
+	for (i=0; i<work.num_locales; i++)
+	{
+		free(work.runs[i].name);
+		free(work.runs[i].output);
+	}
+	free(work.runs);
+	free(threads);
+	free(work.local);
+	free(data);
+	exit(num_changed != 0);
+}
@@ -0,0 +1,275 @@
+ /** zdnames.c                          http://libhdate.sourceforge.net
+ *   zdnames - the zone names of a zoneinfo directory, hashed
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdnames.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc, qsort, getenv, realpath
+#include <string.h> 	/// for strcmp, memcmp, strdup
+#include <strings.h>	/// for strcasecmp
+#include <ctype.h>		/// for tolower
+#include <limits.h>		/// for PATH_MAX
+#include <fcntl.h>		/// for open
+#include <unistd.h>		/// for read, close
+#include <dirent.h>		/// for opendir, readdir
+#include <sys/stat.h>	/// for stat, lstat
+#include "zdnames.h"
+
+/// name_file - a name found by the scan, and the file it names
+typedef struct {
+	char		*name;
+	dev_t		dev;
+	ino_t		ino;
+	int			is_link;
+	} name_file;
+
+/// name_list - the names found so far
+typedef struct {
+	int			num_entries;
+	int			max_entries;
+	name_file	*entries;
+	} name_list;
+
+static const zdnames* names_in_use = NULL;
+
+
+static unsigned int name_hash( const char* name, const int fold )
+{
+	/// FNV-1a, of the name or of its lower case
+	unsigned int hash = 2166136261u;
+
+	while (*name)
+	{
+		hash ^= fold ? (unsigned char) tolower( (unsigned char) *name ) : (unsigned char) *name;
+		hash *= 16777619u;
+		name++;
+	}
+	return hash;
+}
+
+static int name_slot( const zdnames* names, const int* slots, const char* name,
+					  const int fold )
+{
+	/// the slot holding 'name', or the empty one ending its probe
+	unsigned int mask = names->num_slots - 1;
+	unsigned int i = name_hash( name, fold ) & mask;
+
+	while ((slots[i] >= 0) &&
+		   (fold ? strcasecmp( names->names[ slots[i] ].name, name )
+				 : strcmp( names->names[ slots[i] ].name, name )))
+		i = (i + 1) & mask;
+	return i;
+}
+
+static int is_tzif( const char* path )
+{
+	char magic[4];
+	int fd;
+	int found;
+
+	fd = open( path, O_RDONLY );
+	if (fd < 0) return 0;
+	found = (read( fd, magic, 4 ) == 4) && !memcmp( magic, "TZif", 4 );
+	close(fd);
+	return found;
+}
+
+static int add_name( name_list* list, const char* name, const struct stat* file_status,
+					 const int is_link )
+{
+	name_file* new_entries;
+
+	if (list->num_entries == list->max_entries)
+	{
+		list->max_entries = list->max_entries ? list->max_entries * 2 : 256;
+		new_entries = realloc( list->entries, sizeof(name_file) * list->max_entries );
+		if (new_entries == NULL) return ZD_MALLOC;
+		list->entries = new_entries;
+	}
+	list->entries[list->num_entries].name = strdup(name);
+	if (list->entries[list->num_entries].name == NULL) return ZD_MALLOC;
+	list->entries[list->num_entries].dev = file_status->st_dev;
+	list->entries[list->num_entries].ino = file_status->st_ino;
+	list->entries[list->num_entries].is_link = is_link;
+	list->num_entries++;
+	return ZD_SUCCESS;
+}
+
+static int scan( name_list* list, char* path, const size_t root_len )
+{
+	/// add every TZif file below 'path', which has room for PATH_MAX,
+	/// as zddb_load() does, but following symbolic links to files
+	DIR* dir;
+	struct dirent* entry;
+	struct stat link_status, file_status;
+	size_t path_len = strlen(path);
+	int result = ZD_SUCCESS;
+
+	dir = opendir(path);
+	if (dir == NULL) return ZD_DIR_PATH;
+	while ((result == ZD_SUCCESS) && ((entry = readdir(dir)) != NULL))
+	{
+		if ((entry->d_name[0] == '.') || !strcmp(entry->d_name, "posix") ||
+			!strcmp(entry->d_name, "right") || !strcmp(entry->d_name, "localtime")) continue;
+		if (path_len + strlen(entry->d_name) + 2 > PATH_MAX) continue;
+		path[path_len] = '/';
+		strcpy( &path[path_len + 1], entry->d_name );
+		if ((lstat( path, &link_status ) == 0) && (stat( path, &file_status ) == 0))
+		{
+			if (S_ISDIR(link_status.st_mode)) result = scan( list, path, root_len );
+			else if (S_ISREG(file_status.st_mode) && is_tzif(path))
+				result = add_name( list, &path[root_len + 1], &file_status,
+								   S_ISLNK(link_status.st_mode) );
+		}
+		path[path_len] = '\0';
+	}
+	closedir(dir);
+	return result;
+}
+
+static int alias_before( const void* a, const void* b )
+{
+	/// names of one file together, the one to stand for them first
+	const name_file* x = a;
+	const name_file* y = b;
+	int x_area = strchr( x->name, '/' ) != NULL;
+	int y_area = strchr( y->name, '/' ) != NULL;
+
+	if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+	if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+	if (x->is_link != y->is_link) return x->is_link - y->is_link;
+	if (x_area != y_area) return y_area - x_area;
+	return strcmp( x->name, y->name );
+}
+
+
+int zdnames_load( const char* tzdir, zdnames** names )
+{
+	char* tzdirlist[2] = { "/usr/share/zoneinfo",	/// libc >= 5.4.6
+						   "/usr/lib/zoneinfo" };	/// libc <  5.4.6
+	char path[PATH_MAX];
+	struct stat dir_status;
+	name_list list;
+	zdnames* zn = NULL;
+	int result;
+	int i, slot;
+
+	*names = NULL;
+	memset( &list, '\0', sizeof(list) );
+	/// as zddb_load(): a directory asked for must exist, and is made
+	/// absolute, as names are later joined to it
+	if (tzdir != NULL)
+	{
+		if (stat( tzdir, &dir_status ) || !S_ISDIR(dir_status.st_mode)) return ZD_DIR_PATH;
+	}
+	else
+	{
+		tzdir = getenv("TZDIR");
+		if ((tzdir == NULL) || stat( tzdir, &dir_status ) || !S_ISDIR(dir_status.st_mode))
+			tzdir = stat( tzdirlist[0], &dir_status ) ? tzdirlist[1] : tzdirlist[0];
+	}
+	if (realpath( tzdir, path ) == NULL) return ZD_DIR_PATH;
+
+	result = scan( &list, path, strlen(path) );
+	if (result != ZD_SUCCESS) goto endpoint;
+	if (!list.num_entries) {result= ZD_FOPEN; goto endpoint;};
+	qsort( list.entries, list.num_entries, sizeof(name_file), alias_before );
+
+	zn = calloc( 1, sizeof(zdnames) );
+	if (zn == NULL) {result= ZD_MALLOC; goto endpoint;};
+	zn->tzdir = strdup(path);
+	zn->names = calloc( list.num_entries, sizeof(zdname) );
+	for (zn->num_slots = 16; zn->num_slots < 2 * list.num_entries; zn->num_slots *= 2);
+	zn->exact = malloc( sizeof(int) * zn->num_slots );
+	zn->folded = malloc( sizeof(int) * zn->num_slots );
+	if ((zn->tzdir == NULL) || (zn->names == NULL) || (zn->exact == NULL) ||
+		(zn->folded == NULL)) {result= ZD_MALLOC; goto endpoint;};
+	memset( zn->exact, 0xff, sizeof(int) * zn->num_slots );
+	memset( zn->folded, 0xff, sizeof(int) * zn->num_slots );
+
+	/// the names pass to the index; a folded name shared by two files
+	/// finds the first
+	for (i=0; i<list.num_entries; i++)
+	{
+		zn->names[i].name = list.entries[i].name;
+		list.entries[i].name = NULL;
+		zn->names[i].canonical = i;
+		if (i && (list.entries[i].dev == list.entries[i-1].dev) &&
+			(list.entries[i].ino == list.entries[i-1].ino))
+			zn->names[i].canonical = zn->names[i-1].canonical;
+		zn->num_names++;
+		slot = name_slot( zn, zn->exact, zn->names[i].name, 0 );
+		zn->exact[slot] = i;
+		slot = name_slot( zn, zn->folded, zn->names[i].name, 1 );
+		if (zn->folded[slot] < 0) zn->folded[slot] = i;
+	}
+	*names = zn;
+	zn = NULL;
+
+/// cleanup and exit
+endpoint:
+	zdnames_free(zn);
+	for (i=0; i<list.num_entries; i++) free( list.entries[i].name );
+	free(list.entries);
+	return result;
+}
+
+void zdnames_free( zdnames* names )
+{
+	int i;
+
+	if (names == NULL) return;
+	for (i=0; i<names->num_names; i++) free( names->names[i].name );
+	free(names->names);
+	free(names->exact);
+	free(names->folded);
+	free(names->tzdir);
+	free(names);
+}
+
+int zdnames_find( const zdnames* names, const char* name )
+{
+	int i;
+
+	i = names->exact[ name_slot( names, names->exact, name, 0 ) ];
+	if (i < 0) i = names->folded[ name_slot( names, names->folded, name, 1 ) ];
+	return i < 0 ? -1 : names->names[i].canonical;
+}
+
+void zdnames_use( const zdnames* names )
+{
+	names_in_use = names;
+}
+
+const zdnames* zdnames_in_use( void )
+{
+	return names_in_use;
+}
+
+const char* zdnames_canonical( const char* tzname )
+{
+	const zdnames* names = names_in_use;
+	int i;
+
+	if ((names == NULL) || (tzname == NULL) || (tzname[0] == '/')) return tzname;
+	i = zdnames_find( names, tzname );
+	return i < 0 ? tzname : names->names[i].name;
+}
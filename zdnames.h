@@ -0,0 +1,97 @@
+/** zdnames.h           http://libhdate.sourceforge.net
+ * An index of the zone names of a zoneinfo directory, so that a name is
+ * resolved by a hash lookup instead of probing the filesystem.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDNAMES_H
+#define ZDNAMES_H
+#include "zdump3.h"		/// for ZD_* error codes
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The directory is scanned once, following symbolic links, for every
+/// TZif file below it ('posix', 'right' and 'localtime' excepted). Names
+/// of the same file, whether linked or copied by inode, are aliases of
+/// one canonical name: the first of them in order that is not a symbolic
+/// link and has an area (eg. America/New_York rather than US/Eastern or
+/// EST5EDT). Names are found exactly, or else ignoring case.
+///
+/// Once put in use with zdnames_use(), zdump(), zdzone_load() and the
+/// zone cache resolve relative names through the index, reading a zone's
+/// file by its known path with no search of TZDIR and the system
+/// directories. zdump() and zdump_multi() then keep every zone they read
+/// in the zone cache, under its canonical name, so that later calls for
+/// it or any of its aliases touch no file at all; zdzone_load() still
+/// reads the file each time. A name the index lacks (eg. right/UTC,
+/// posix/America/New_York or localtime) is looked for in those
+/// directories, as without an index.
+typedef struct {
+	char		*name;		/// relative to tzdir (eg. US/Eastern)
+	int			canonical;	/// index of the entry naming the same file
+	} zdname;
+
+typedef struct {
+	char		*tzdir;		/// the directory scanned, made absolute
+	int			num_names;
+	zdname		*names;		/// [num_names] aliases of a file adjacent
+	int			num_slots;	/// a power of two, at least twice num_names
+	int			*exact;		/// [num_slots] open addressed by name, -1 empty
+	int			*folded;	/// [num_slots] the same, ignoring case
+	} zdnames;
+
+extern int
+zdnames_load(            /// returns 0 on success, error code on failure
+    const char* tzdir,   /// directory to scan, ZD_DIR_PATH if it is not
+                         ///    one; if NULL, TZDIR, else the system
+                         ///    zoneinfo directory, as for zdump()
+    zdnames** names      /// upon successful return, a malloc()ed index
+                         ///    to be released with zdnames_free()
+            );
+
+extern void
+zdnames_free( zdnames* names );
+
+extern int
+zdnames_find(            /// returns the index of the canonical entry of
+    const zdnames* names,///    'name', or -1 if it is not in the index
+    const char* name
+            );
+
+extern void
+zdnames_use(             /// resolve names through 'names' from now on, or
+    const zdnames* names ///    again through the filesystem if NULL. Call
+                         ///    it while no other thread is using the
+                         ///    library, and free an index only once it is
+                         ///    no longer in use.
+           );
+
+extern const zdnames*
+zdnames_in_use( void );  /// the index put in use, or NULL
+
+extern const char*
+zdnames_canonical(       /// the canonical name of 'tzname' in the index in
+    const char* tzname   ///    use; 'tzname' itself if there is none, or
+                         ///    'tzname' is NULL, absolute or not found
+                 );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDNAMES_H */
@@ -0,0 +1,153 @@
+ /** zdpack-bench.c                     http://libhdate.sourceforge.net
+ *   zdpack-bench - compare the memory and lookup speed of packed zones
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -O2 zdpack-bench.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -O2 zdpack-bench.c -o zdpack-bench -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH ./zdpack-bench [lookups]
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>    /// for printf
+#include <stdlib.h>   /// for malloc, free, atol
+#include <string.h>   /// for strcmp
+#include <time.h>     /// for clock_gettime
+#include <zdump3.h>   /// for zddb, zdzone_span
+#include <zdpack.h>   /// for zdpack_build, zdpack_span
+
+#define DEFAULT_LOOKUPS 2000000
+
+/// lookups are spread over 1900 to 2100, in a fixed pseudo-random order
+#define SPREAD_START (-2208988800L)
+#define SPREAD_SECS  (6311433600UL)
+
+static double seconds_now( void )
+{
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+static int span_differs( const zdspan* a, const zdspan* b )
+{
+	return (a->lo != b->lo) || (a->hi != b->hi) || (a->index != b->index) ||
+		   (a->info.utc_offset != b->info.utc_offset) ||
+		   (a->info.save_secs != b->info.save_secs) || strcmp( a->info.abbr, b->info.abbr );
+}
+
+int main (int argc, char *argv[])
+{
+	zddb* db;
+	zdpack** packs;
+	long num_lookups = DEFAULT_LOOKUPS;
+	int* zone_of;
+	time_t* times;
+	zdspan span, packed_span;
+	size_t zone_bytes = 0, pack_bytes = 0;
+	double start, zone_secs, pack_secs;
+	unsigned long seed = 12345;
+	long i, mismatches = 0;
+	long sink = 0;		/// keeps the timed loops; 0 when both agree
+	int result;
+
+	if (argc > 2)
+	{
+		printf("\
+zdpack-bench: compare the memory and lookup speed of packed zones\n\
+usage: ./zdpack-bench [lookups]\n");
+		exit(0);
+	}
+	if (argc == 2) num_lookups = atol(argv[1]);
+	if (num_lookups <= 0) num_lookups = DEFAULT_LOOKUPS;
+
+	result = zddb_load( NULL, &db );
+	if (result != ZD_SUCCESS)
+	{
+		printf("error %d loading the zoneinfo directory\n", result);
+		exit(1);
+	}
+	packs = malloc( sizeof(zdpack*) * db->num_zones );
+	zone_of = malloc( sizeof(int) * num_lookups );
+	times = malloc( sizeof(time_t) * num_lookups );
+	if ((packs == NULL) || (zone_of == NULL) || (times == NULL))
+	{
+		printf("memory allocation error\n");
+		exit(1);
+	}
+	for (i=0; i<db->num_zones; i++)
+	{
+		result = zdpack_build( db->zones[i], &packs[i] );
+		if (result != ZD_SUCCESS)
+		{
+			printf("error %d packing %s\n", result, db->names[i]);
+			exit(1);
+		}
+	}
+	/// once all are built, so that what packs share is counted in shares
+	for (i=0; i<db->num_zones; i++)
+	{
+		zone_bytes += zdzone_size( db->zones[i] );
+		pack_bytes += zdpack_size( packs[i] );
+	}
+	for (i=0; i<num_lookups; i++)
+	{
+		seed = (seed * 6364136223846793005UL) + 1442695040888963407UL;
+		zone_of[i] = (seed >> 33) % db->num_zones;
+		times[i] = SPREAD_START + (long) ((seed >> 11) % SPREAD_SECS);
+	}
+
+	start = seconds_now();
+	for (i=0; i<num_lookups; i++)
+	{
+		zdzone_span( db->zones[ zone_of[i] ], times[i], &span );
+		sink += span.info.utc_offset;
+	}
+	zone_secs = seconds_now() - start;
+
+	start = seconds_now();
+	for (i=0; i<num_lookups; i++)
+	{
+		zdpack_span( packs[ zone_of[i] ], times[i], &packed_span );
+		sink -= packed_span.info.utc_offset;
+	}
+	pack_secs = seconds_now() - start;
+
+	for (i=0; i<num_lookups; i++)
+	{
+		zdzone_span( db->zones[ zone_of[i] ], times[i], &span );
+		zdpack_span( packs[ zone_of[i] ], times[i], &packed_span );
+		if (span_differs( &span, &packed_span )) mismatches++;
+	}
+
+	printf("zones: %d    lookups: %ld    mismatches: %ld\n", db->num_zones, num_lookups, mismatches);
+	printf("            bytes   bytes/zone   ns/lookup\n");
+	printf("zdzone %10zu %12.0f %11.1f\n", zone_bytes, (double) zone_bytes / db->num_zones,
+		   zone_secs * 1e9 / num_lookups);
+	printf("zdpack %10zu %12.0f %11.1f\n", pack_bytes, (double) pack_bytes / db->num_zones,
+		   pack_secs * 1e9 / num_lookups);
+	printf("ratio  %10.2f %12s %11.2f\n", (double) zone_bytes / pack_bytes, "",
+		   pack_secs / zone_secs);
+
+	for (i=0; i<db->num_zones; i++) zdpack_free(packs[i]);
+	free(packs);
+	free(zone_of);
+	free(times);
+	zddb_free(db);
+	exit((mismatches != 0) || (sink != 0));
+}
@@ -0,0 +1,559 @@
+ /** zdpack.c                           http://libhdate.sourceforge.net
+ *   zdpack - compact, read-only encoding of a parsed zone
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdpack.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>		/// for malloc
+#include <string.h> 	/// for memcpy, memcmp
+#include <stdint.h>		/// for uint64_t
+#include <pthread.h>	/// for pthread_mutex_lock
+#include "zdpack.h"
+
+#define MAX_VARINT_SIZE 10	/// of a uint64_t, 7 bits to a byte
+#define PERIOD (364 * 86400L)	/// 52 weeks: a rule's transition a year on
+#define STATE_CHUNK 256
+#define MAX_STATE_IDS 65536
+
+/// the units a distance is counted in, the largest it is a whole number of
+static const int64_t units[4] = { 1, 60, 3600, 86400 };
+
+/// zdpack_rule - a DST footer rule shared by every pack having it, as a
+/// zone of no transitions, which zdzone_span() expands directly
+typedef struct zdpack_rule {
+	zdzone		zone;
+	int			refs;
+	struct zdpack_rule *next;
+	} zdpack_rule;
+
+/// zdpack_state - a local time type and the save_secs of a transition
+/// into it, shared by every pack having it and named by its id
+typedef struct {
+	int			utc_offset;
+	int			save_secs;
+	char		abbr[MAX_TZ_ABBR_SIZE];
+	int			refs;		/// 0 while the id is free
+	} zdpack_state;
+
+/// the shared rules and states. States are kept in chunks that never
+/// move, so that lookups read them without the lock
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static zdpack_rule* rules = NULL;
+static zdpack_state* state_chunks[ MAX_STATE_IDS / STATE_CHUNK ];
+static int num_state_ids = 0;
+
+/// zdpack - one allocation: the header, the stream offset of each block,
+/// the state id of each state (uint16_t [num_states + 1], the first being
+/// the state before the first transition) and the stream. A block begins with three varints:
+/// its first time, as a zigzag distance back from 'last', the index of
+/// that transition and its state. Each later transition is one varint,
+/// ((((value << 2) | unit) << 1 | periodic) << state_bits) | state, its
+/// value being its distance from the transition before, or when periodic
+/// the zigzag of its distance from the one two before less PERIOD, in
+/// units[unit]
+struct zdpack {
+	time_t		last;			/// the last transition, kept whole for
+	zdpack_rule	*rule;			///    lookups past it; NULL without a
+	int			timecnt;		///    DST footer rule
+	uint32_t	num_blocks;
+	uint32_t	stream_size;
+	uint16_t	num_states;
+	uint16_t	last_state;
+	unsigned char state_bits;
+	uint32_t	blocks[];		/// [num_blocks], then the state ids and stream
+	};
+
+
+static const uint16_t* pack_states( const zdpack* pack )
+{
+	return (const uint16_t*) &pack->blocks[ pack->num_blocks ];
+}
+
+static const unsigned char* pack_stream( const zdpack* pack )
+{
+	return (const unsigned char*) &pack_states(pack)[ pack->num_states + 1 ];
+}
+
+static size_t put_varint( unsigned char* out, uint64_t value )
+{
+	size_t len = 0;
+
+	while (value >= 0x80)
+	{
+		out[len++] = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	out[len++] = (unsigned char) value;
+	return len;
+}
+
+static const unsigned char* get_varint( const unsigned char* in, uint64_t* value )
+{
+	int shift = 0;
+
+	*value = 0;
+	while (*in & 0x80)
+	{
+		*value |= (uint64_t) (*in++ & 0x7f) << shift;
+		shift += 7;
+	}
+	*value |= (uint64_t) *in++ << shift;
+	return in;
+}
+
+static int varint_size( uint64_t value )
+{
+	int len = 1;
+
+	while (value >= 0x80)
+	{
+		value >>= 7;
+		len++;
+	}
+	return len;
+}
+
+static uint64_t zigzag( const int64_t value )
+{
+	return value < 0 ? ((uint64_t) -(value + 1) << 1) | 1 : (uint64_t) value << 1;
+}
+
+static int64_t unzigzag( const uint64_t value )
+{
+	return value & 1 ? -(int64_t) (value >> 1) - 1 : (int64_t) (value >> 1);
+}
+
+static int transition_code( const time_t* transitions, const int i, const int periodic,
+							const int state_bits, const int state, uint64_t* code )
+{
+	/// the shorter varint code of transition i, from the transition before
+	/// or, if 'periodic', from PERIOD after the one two before; 0 if
+	/// neither fits, to begin a block
+	uint64_t limit = UINT64_MAX >> (3 + state_bits);
+	uint64_t distance = (uint64_t) transitions[i] - (uint64_t) transitions[i-1];
+	uint64_t value, candidate;
+	int64_t from_period;
+	int found = 0;
+	int unit;
+
+	for (unit = 3; distance % units[unit]; unit--);
+	value = distance / units[unit];
+	if (value <= limit)
+	{
+		*code = ((((value << 2) | unit) << 1) << state_bits) | state;
+		found = 1;
+	}
+	if (periodic) distance = (uint64_t) transitions[i] - (uint64_t) transitions[i-2];
+	if (periodic && (distance <= INT64_MAX))
+	{
+		from_period = (int64_t) distance - PERIOD;
+		for (unit = 3; from_period % units[unit]; unit--);
+		value = zigzag( from_period / units[unit] );
+		candidate = ((((((value << 2) | unit) << 1) | 1)) << state_bits) | state;
+		if ((value <= limit) && (!found || (varint_size(candidate) < varint_size(*code))))
+		{
+			*code = candidate;
+			found = 1;
+		}
+	}
+	return found;
+}
+
+static time_t code_time( const uint64_t code, const int state_bits, const time_t previous,
+						 const time_t before )
+{
+	/// the time of a transition coded after 'previous', and 'before' it
+	uint64_t value = code >> (state_bits + 3);
+	int64_t unit = units[ (code >> (state_bits + 1)) & 3 ];
+
+	if ((code >> state_bits) & 1)
+		return (time_t) ((uint64_t) before + PERIOD + (uint64_t) (unzigzag(value) * unit));
+	return (time_t) ((uint64_t) previous + (value * unit));
+}
+
+static const unsigned char* block_head( const zdpack* pack, const uint32_t block,
+										time_t* first, int* index, int* state )
+{
+	const unsigned char* in = &pack_stream(pack)[ pack->blocks[block] ];
+	uint64_t value;
+
+	in = get_varint( in, &value );
+	*first = (time_t) ((uint64_t) pack->last - (uint64_t) unzigzag(value));
+	in = get_varint( in, &value );
+	if (index != NULL) *index = (int) value;
+	in = get_varint( in, &value );
+	if (state != NULL) *state = (int) value;
+	return in;
+}
+
+static zdpack_rule* rule_share( const rule_detail* rule )
+{
+	/// the shared copy of rule, made now if there is none
+	zdpack_rule* shared;
+
+	pthread_mutex_lock(&pool_lock);
+	for (shared = rules; shared != NULL; shared = shared->next)
+		if (!memcmp( &shared->zone.rule, rule, sizeof(rule_detail) )) break;
+	if (shared == NULL)
+	{
+		shared = calloc( 1, sizeof(zdpack_rule) );
+		if (shared != NULL)
+		{
+			shared->zone.has_rule = 1;
+			shared->zone.rule = *rule;
+			shared->next = rules;
+			rules = shared;
+		}
+	}
+	if (shared != NULL) shared->refs++;
+	pthread_mutex_unlock(&pool_lock);
+	return shared;
+}
+
+static void rule_release( zdpack_rule* shared )
+{
+	zdpack_rule** link;
+
+	if (shared == NULL) return;
+	pthread_mutex_lock(&pool_lock);
+	if (--shared->refs == 0)
+	{
+		for (link = &rules; *link != shared; link = &(*link)->next);
+		*link = shared->next;
+		free(shared);
+	}
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static zdpack_state* state_at( const int id )
+{
+	return &state_chunks[ id / STATE_CHUNK ][ id % STATE_CHUNK ];
+}
+
+static int state_share( const int utc_offset, const int save_secs, const char* abbr )
+{
+	/// the id of the shared state, made now if there is none; -1 if no id
+	/// is left. There are seldom more than a few hundred
+	zdpack_state key;
+	int id, free_id = -1;
+
+	memset( &key, '\0', sizeof(key) );
+	key.utc_offset = utc_offset;
+	key.save_secs = save_secs;
+	strncpy( key.abbr, abbr, MAX_TZ_ABBR_SIZE - 1 );
+	pthread_mutex_lock(&pool_lock);
+	for (id=0; id<num_state_ids; id++)
+	{
+		if (!state_at(id)->refs)
+		{
+			if (free_id < 0) free_id = id;
+		}
+		else if ((state_at(id)->utc_offset == key.utc_offset) &&
+				 (state_at(id)->save_secs == key.save_secs) &&
+				 !memcmp( state_at(id)->abbr, key.abbr, MAX_TZ_ABBR_SIZE )) break;
+	}
+	if (id == num_state_ids)
+	{
+		id = free_id;
+		if ((id < 0) && (num_state_ids < MAX_STATE_IDS))
+		{
+			if (state_chunks[ num_state_ids / STATE_CHUNK ] == NULL)
+				state_chunks[ num_state_ids / STATE_CHUNK ] = calloc( STATE_CHUNK, sizeof(zdpack_state) );
+			if (state_chunks[ num_state_ids / STATE_CHUNK ] != NULL) id = num_state_ids++;
+		}
+		if (id >= 0) *state_at(id) = key;
+	}
+	if (id >= 0) state_at(id)->refs++;
+	pthread_mutex_unlock(&pool_lock);
+	return id;
+}
+
+static void state_release( const uint16_t* ids, const int num_ids )
+{
+	int i;
+
+	pthread_mutex_lock(&pool_lock);
+	for (i=0; i<num_ids; i++) state_at(ids[i])->refs--;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+
+int zdpack_build( const zdzone* zone, zdpack** pack )
+{
+	zdpack* zp = NULL;
+	zdspan initial;
+	int* state_of = NULL;	/// each transition's state
+	int* state_type = NULL;	/// each state's (type, save_secs) pair
+	int* state_save = NULL;
+	uint32_t* blocks = NULL;
+	unsigned char* stream = NULL;
+	uint16_t* ids;
+	size_t stream_size = 0;
+	uint32_t num_blocks = 0;
+	uint64_t code;
+	time_t last = 0;
+	int num_states = 0, state_bits = 0;
+	int block_start = 0;
+	int num_ids = 0;
+	int result = ZD_MALLOC;
+	int i, j, id;
+
+	*pack = NULL;
+	if ((zone->timecnt < 0) || (zone->timecnt > (int) (UINT32_MAX / (3 * MAX_VARINT_SIZE))))
+		return ZD_BAD_VALUES;
+	state_of = malloc( sizeof(int) * (zone->timecnt + 1) );
+	state_type = malloc( sizeof(int) * (zone->timecnt + 1) );
+	state_save = malloc( sizeof(int) * (zone->timecnt + 1) );
+	blocks = malloc( sizeof(uint32_t) * (zone->timecnt + 1) );
+	stream = malloc( 3 * MAX_VARINT_SIZE * (zone->timecnt + 1) );
+	if ((state_of == NULL) || (state_type == NULL) || (state_save == NULL) ||
+		(blocks == NULL) || (stream == NULL)) goto endpoint;
+
+	/// the distinct (type, save_secs) pairs; there are seldom more than a few
+	for (i=0; i<zone->timecnt; i++)
+	{
+		for (j=0; j<num_states; j++)
+			if ((state_type[j] == zone->types[i]) && (state_save[j] == zone->save_secs[i]))
+				break;
+		if (j == num_states)
+		{
+			if (num_states == MAX_STATE_IDS - 1) {result= ZD_BAD_VALUES; goto endpoint;};
+			state_type[j] = zone->types[i];
+			state_save[j] = zone->save_secs[i];
+			num_states++;
+		}
+		state_of[i] = j;
+	}
+	while ((1 << state_bits) < num_states) state_bits++;
+	if (zone->timecnt) last = zone->transitions[ zone->timecnt - 1 ];
+
+	/// a block ends after ZDPACK_BLOCK transitions, or early when a
+	/// transition cannot be coded from those before (eg. after a 'big
+	/// bang' time, or out of order)
+	for (i=0; i<zone->timecnt; i++)
+	{
+		if (i && (i - block_start < ZDPACK_BLOCK) &&
+			(zone->transitions[i] >= zone->transitions[i-1]) &&
+			transition_code( zone->transitions, i, i - block_start >= 2, state_bits,
+							 state_of[i], &code ))
+		{
+			stream_size += put_varint( &stream[stream_size], code );
+			continue;
+		}
+		block_start = i;
+		blocks[num_blocks++] = stream_size;
+		stream_size += put_varint( &stream[stream_size],
+								   zigzag( (int64_t) ((uint64_t) last - (uint64_t) zone->transitions[i]) ) );
+		stream_size += put_varint( &stream[stream_size], i );
+		stream_size += put_varint( &stream[stream_size], state_of[i] );
+	}
+
+	zp = calloc( 1, sizeof(zdpack) + (sizeof(uint32_t) * num_blocks) +
+					(sizeof(uint16_t) * (num_states + 1)) + stream_size );
+	if (zp == NULL) goto endpoint;
+	zp->last = last;
+	zp->timecnt = zone->timecnt;
+	zp->num_blocks = num_blocks;
+	zp->stream_size = stream_size;
+	zp->num_states = num_states;
+	zp->last_state = zone->timecnt ? state_of[ zone->timecnt - 1 ] : 0;
+	zp->state_bits = state_bits;
+	memcpy( zp->blocks, blocks, sizeof(uint32_t) * num_blocks );
+	memcpy( (unsigned char*) pack_stream(zp), stream, stream_size );
+
+	/// the state before the first transition, or at all times, is the
+	/// zone's own; only a rule with DST is kept
+	ids = (uint16_t*) pack_states(zp);
+	zdzone_span( zone, ZD_TIME_MIN, &initial );
+	for (num_ids=0; num_ids<=num_states; num_ids++)
+	{
+		if (!num_ids)
+			id = state_share( initial.info.utc_offset, 0, initial.info.abbr );
+		else
+			id = state_share( zone->ttinfo[ state_type[num_ids-1] ].utc_offset,
+							  state_save[num_ids-1], zone->ttinfo[ state_type[num_ids-1] ].abbr );
+		if (id < 0) goto endpoint;
+		ids[num_ids] = id;
+	}
+	if (zone->has_rule && zone->rule.has_dst &&
+		((zp->rule = rule_share( &zone->rule )) == NULL)) goto endpoint;
+	result = ZD_SUCCESS;
+
+/// cleanup and exit
+endpoint:
+	free(state_of);
+	free(state_type);
+	free(state_save);
+	free(blocks);
+	free(stream);
+	if (result == ZD_SUCCESS) *pack = zp;
+	else if (zp != NULL)
+	{
+		state_release( pack_states(zp), num_ids );
+		free(zp);
+	}
+	return result;
+}
+
+void zdpack_free( zdpack* pack )
+{
+	if (pack == NULL) return;
+	rule_release(pack->rule);
+	state_release( pack_states(pack), pack->num_states + 1 );
+	free(pack);
+}
+
+size_t zdpack_size( const zdpack* pack )
+{
+	/// shared rules and states are counted in equal shares among the packs
+	/// holding them, rounded up
+	size_t size = sizeof(zdpack) + (sizeof(uint32_t) * pack->num_blocks) +
+				  (sizeof(uint16_t) * (pack->num_states + 1)) + pack->stream_size;
+	int i, refs;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pack->rule != NULL)
+		size += (sizeof(zdpack_rule) + pack->rule->refs - 1) / pack->rule->refs;
+	for (i=0; i<=pack->num_states; i++)
+	{
+		refs = state_at( pack_states(pack)[i] )->refs;
+		size += (sizeof(zdpack_state) + refs - 1) / refs;
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return size;
+}
+
+static void state_ttinfo( const zdpack* pack, const int k, zdttinfo* ttinfo, int* save_secs )
+{
+	/// the k'th state of the pack, as a window's local time type
+	const zdpack_state* state = state_at( pack_states(pack)[k] );
+
+	ttinfo->utc_offset = state->utc_offset;
+	ttinfo->is_dst = 0;
+	memcpy( ttinfo->abbr, state->abbr, MAX_TZ_ABBR_SIZE );
+	*save_secs = state->save_secs;
+}
+
+void zdpack_span( const zdpack* pack, const time_t t, zdspan* span )
+{
+	/// decode the transition in effect at t, and the one after it, into a
+	/// window of the zone that zdzone_span() can answer from. Past the
+	/// last transition, the shared rule answers alone once its interval
+	/// begins after that transition; nothing is decoded
+	zdzone window;
+	zdttinfo ttinfo[2];
+	time_t times[2];
+	unsigned char types[2];
+	int save_secs[2];
+	const unsigned char* next;
+	const unsigned char* after;
+	uint64_t code;
+	time_t before, when;
+	int lo, hi, mid;
+	int i, end, state;
+
+	if ((pack->rule != NULL) && ((pack->timecnt == 0) || (t >= pack->last)))
+	{
+		zdzone_span( &pack->rule->zone, t, span );
+		if ((pack->timecnt == 0) || (span->lo > pack->last))
+		{
+			span->index = pack->timecnt;
+			return;
+		}
+	}
+	window.timecnt = 0;
+	window.typecnt = 2;
+	window.transitions = times;
+	window.types = types;
+	window.save_secs = save_secs;
+	window.ttinfo = ttinfo;
+	window.has_rule = 0;
+	window.is_fixed = 0;
+	state_ttinfo( pack, 0, &ttinfo[0], &save_secs[0] );
+	if (pack->timecnt == 0)
+	{
+		/// a zone of one local time type
+		zdzone_span( &window, t, span );
+		return;
+	}
+	if (t >= pack->last)
+	{
+		i = pack->timecnt - 1;
+		times[0] = pack->last;
+		state = pack->last_state;
+	}
+	else
+	{
+		/// the last block beginning at or before t
+		lo = 0;
+		hi = pack->num_blocks - 1;
+		while (lo < hi)
+		{
+			mid = lo + ((hi - lo + 1) / 2);
+			block_head( pack, mid, &when, NULL, NULL );
+			if (when <= t) lo = mid;
+			else hi = mid - 1;
+		}
+		next = block_head( pack, lo, &times[0], &i, &state );
+		if (lo + 1 < (int) pack->num_blocks) block_head( pack, lo + 1, &times[1], &end, NULL );
+		else
+		{
+			end = pack->timecnt;
+			times[1] = ZD_TIME_MAX;
+		}
+		before = times[0];
+		while (i + 1 < end)
+		{
+			after = get_varint( next, &code );
+			when = code_time( code, pack->state_bits, times[0], before );
+			if (when > t)
+			{
+				times[1] = when;
+				break;
+			}
+			before = times[0];
+			times[0] = when;
+			state = code & ((1 << pack->state_bits) - 1);
+			next = after;
+			i++;
+		}
+	}
+	if (i + 1 == pack->timecnt) times[1] = ZD_TIME_MAX;
+
+	/// before the first transition the window is the first alone
+	types[0] = types[1] = 1;
+	state_ttinfo( pack, state + 1, &ttinfo[1], &save_secs[0] );
+	save_secs[1] = save_secs[0];
+	if (t < times[0]) window.timecnt = 1;
+	else if (i + 1 < pack->timecnt) window.timecnt = 2;
+	else
+	{
+		/// from the last transition to the rule's first edge after it
+		window.timecnt = 1;
+		if (pack->rule != NULL)
+		{
+			window.has_rule = 1;
+			window.rule = pack->rule->zone.rule;
+		}
+	}
+	zdzone_span( &window, t, span );
+	if (span->index >= 0) span->index += i;
+}
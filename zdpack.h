@@ -0,0 +1,62 @@
+/** zdpack.h            http://libhdate.sourceforge.net
+ * A compact, read-only encoding of a parsed zone, for large resident
+ * collections of zones.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDPACK_H
+#define ZDPACK_H
+#include "zdump3.h"		/// for zdzone, zdspan
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// zdpack - a zone whose transitions are stored as varints, in blocks of
+/// up to ZDPACK_BLOCK. Each transition takes one varint holding its local
+/// time type and either its distance from the previous one or, for the
+/// yearly transitions of a rule, its distance from 52 weeks after the one
+/// two before, in the largest of seconds, minutes, hours or days that is
+/// exact; lookups decode one block, found by a binary search of the
+/// blocks' first times. The local time types and DST footer rules are
+/// shared among all packs having them, and times past the last transition
+/// are answered from the rule without decoding. The pack holds no
+/// pointers into the zone it was built from.
+#define ZDPACK_BLOCK 32
+typedef struct zdpack zdpack;
+
+extern int
+zdpack_build(            /// returns 0 on success, error code on failure
+    const zdzone* zone,
+    zdpack** pack        /// upon successful return, a malloc()ed pack to
+                         ///    be released with zdpack_free()
+            );
+
+extern void
+zdpack_free( zdpack* pack );
+
+extern size_t
+zdpack_size( const zdpack* pack );  /// bytes held by a pack, as zdzone_size()
+
+extern void
+zdpack_span( const zdpack* pack, const time_t t, zdspan* span );
+                         /// as zdzone_span() on the zone packed
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDPACK_H */
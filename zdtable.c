@@ -0,0 +1,127 @@
+ /** zdtable.c                          http://libhdate.sourceforge.net
+ *   zdtable - direct-indexed lookup of a zone's state at a time
+ *
+ * compile:
+ *  gcc -c -Wall -Werror -fPIC zdtable.c
+ * build: (together with zdump3.o)
+ *  gcc -shared -pthread -o libzdump3.so zdump3.o zdfmt.o zdindex.o zdcache.o zdclient.o zdpack.o zdcalendar.o zdcompare.o zdlocal.o zdtable.o zdnames.o
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>		/// for INT_MAX
+#include <stdlib.h>		/// for malloc
+#include "zdtable.h"
+
+
+static int choose_shift( const zdtimeline* tl )
+{
+	/// buckets no longer than the shortest interval between transitions,
+	/// unless that would take too many of them
+	time_t gap = ZD_TIME_MAX;
+	time_t span = tl->entries[ tl->num_entries - 1 ].start - tl->entries[1].start;
+	int shift = ZDTABLE_MIN_SHIFT;
+	int i;
+
+	for (i=2; i<tl->num_entries; i++)
+		if (tl->entries[i].start - tl->entries[i-1].start < gap)
+			gap = tl->entries[i].start - tl->entries[i-1].start;
+	while ((shift < ZDTABLE_MAX_SHIFT) && (((time_t) 2 << shift) <= gap)) shift++;
+	while ((shift < ZDTABLE_MAX_SHIFT) && ((span >> shift) >= ZDTABLE_MAX_BUCKETS)) shift++;
+	return shift;
+}
+
+
+int zdtable_build( const zdzone* zone, const long horizon, const int shift,
+				   zdtable** table )
+{
+	zdtable* zt;
+	zdtimeline* tl;
+	time_t bucket_start;
+	int result = ZD_SUCCESS;
+	int i, j, b;
+
+	*table = NULL;
+	if (shift && ((shift < ZDTABLE_MIN_SHIFT) || (shift > ZDTABLE_MAX_SHIFT)))
+		return ZD_BAD_VALUES;
+	zt = calloc( 1, sizeof(zdtable) );
+	if (zt == NULL) return ZD_MALLOC;
+	result = zdtimeline_build( zone, horizon, &zt->timeline );
+	if (result != ZD_SUCCESS) goto endpoint;
+	tl = zt->timeline;
+
+	/// the first interval reaches back to the timeline's begin; a zone
+	/// of one interval needs no buckets
+	zt->base = tl->num_entries > 1 ? tl->entries[1].start : ZD_TIME_MAX;
+	zt->last = tl->entries[ tl->num_entries - 1 ].start;
+	if (tl->num_entries < 2) goto endpoint;
+	zt->shift = shift ? shift : choose_shift(tl);
+	if (((zt->last - zt->base) >> zt->shift) >= INT_MAX) {result= ZD_BAD_VALUES; goto endpoint;};
+	zt->num_buckets = (int) ((zt->last - zt->base) >> zt->shift) + 1;
+	zt->buckets = malloc( sizeof(int) * zt->num_buckets );
+	if (zt->buckets == NULL) {result= ZD_MALLOC; goto endpoint;};
+
+	/// each bucket's interval, from one sweep of the entries
+	i = 1;
+	for (b=0; b<zt->num_buckets; b++)
+	{
+		bucket_start = zt->base + ((time_t) b << zt->shift);
+		while ((i + 1 < tl->num_entries) && (tl->entries[i+1].start <= bucket_start)) i++;
+		zt->buckets[b] = i;
+		for (j = i + 1; (j < tl->num_entries) &&
+			 (tl->entries[j].start - bucket_start < ((time_t) 1 << zt->shift)); j++);
+		if (j - i > 2) zt->crowded = 1;
+	}
+
+/// cleanup and exit
+endpoint:
+	if (result != ZD_SUCCESS)
+	{
+		zdtable_free(zt);
+		return result;
+	}
+	*table = zt;
+	return ZD_SUCCESS;
+}
+
+void zdtable_free( zdtable* table )
+{
+	if (table == NULL) return;
+	zdtimeline_free(table->timeline);
+	free(table->buckets);
+	free(table);
+}
+
+size_t zdtable_size( const zdtable* table )
+{
+	return sizeof(zdtable) + zdtimeline_size(table->timeline) +
+		   (sizeof(int) * table->num_buckets);
+}
+
+const zdumpinfo* zdtable_lookup( const zdtable* table, const time_t t )
+{
+	const zdtimeline* tl = table->timeline;
+	int i;
+
+	if ((t < tl->begin) || (t >= tl->end)) return NULL;
+	if (t < table->base) return &tl->entries[0];
+	if (t >= table->last) return &tl->entries[ tl->num_entries - 1 ];
+	/// t is before the last transition, so entries[i+1] exists
+	i = table->buckets[ (t - table->base) >> table->shift ];
+	i += tl->entries[i+1].start <= t;
+	if (table->crowded) while (tl->entries[i+1].start <= t) i++;
+	return &tl->entries[i];
+}
@@ -0,0 +1,79 @@
+/** zdtable.h           http://libhdate.sourceforge.net
+ * Direct-indexed lookup of a zone's state at a time: one array access and
+ * (usually) one comparison, instead of a binary search.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDTABLE_H
+#define ZDTABLE_H
+#include <stddef.h>		/// for size_t
+#include "zdump3.h"		/// for zdzone, zdtimeline
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The time from a zone's first transition to its last (explicit, or
+/// expanded from the footer rule through a horizon year) is cut into
+/// buckets of 2^shift seconds, each holding the index of the interval in
+/// effect at its start. A lookup takes the bucket of its time, and steps
+/// past a transition within the bucket. When no two transitions are
+/// closer than a bucket, as the automatic choice of shift makes so where
+/// the table stays within ZDTABLE_MAX_BUCKETS, that is one comparison.
+#define ZDTABLE_MIN_SHIFT 12		/// about an hour
+#define ZDTABLE_MAX_SHIFT 30		/// about 34 years
+#define ZDTABLE_MAX_BUCKETS (1 << 20)
+typedef struct {
+	zdtimeline	*timeline;		/// owned; its entries are those returned
+	int			shift;			/// buckets of 2^shift seconds
+	time_t		base;			/// start of the first bucket, the zone's
+	time_t		last;			///    first transition, to its last
+	int			num_buckets;
+	int			*buckets;		/// [num_buckets] index into timeline entries
+	int			crowded;		/// some bucket holds more than one transition,
+								///    so that lookups in it compare further
+	} zdtable;
+
+extern int
+zdtable_build(           /// returns 0 on success, error code on failure
+    const zdzone* zone,  /// must outlive the table
+    const long horizon,  /// as for zdtimeline_build()
+    const int shift,     /// log2 of the bucket size in seconds, from
+                         ///    ZDTABLE_MIN_SHIFT to ZDTABLE_MAX_SHIFT; 0 to
+                         ///    choose it from the closest two transitions
+    zdtable** table      /// upon successful return, a malloc()ed table
+                         ///    to be released with zdtable_free()
+             );
+
+extern void
+zdtable_free( zdtable* table );
+
+extern size_t
+zdtable_size( const zdtable* table );  /// bytes held, as zdzone_size()
+
+extern const zdumpinfo*
+zdtable_lookup(          /// returns the state in effect at t, pointing
+    const zdtable* table,///    into the table; its start is the start of
+    const time_t t       ///    its interval. NULL if t is outside the
+                         ///    timeline's begin to end, for which use
+                         ///    zdzone_span() or a zdcursor.
+              );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDTABLE_H */
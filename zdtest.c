@@ -27,10 +27,9 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <stdio.h>    /// for printf
-#include <stdlib.h>   /// for setenv
-#include <string.h>   /// for strcat
-#include <time.h>     /// for ctime
+#include <stdlib.h>   /// for free
 #include <zdump3.h>   /// for zdump
+#include <zdfmt.h>    /// for zdfmt_entry
 
 /// usage ./zdump3 continent/city $(date --date='1970-01-01 00:00:00' +%s) $(date --date='1970-01-01 00:00:00' +%s)
 
@@ -38,7 +37,7 @@ int main (int argc, char *argv[])
 {
 	int num_entries = 0;
 	void* data = NULL;
-	char lazy_tz[1000];
+	char local_buffer[64];
 	int i;
 
 	zdumpinfo* zd = NULL;
@@ -55,15 +54,12 @@ usage: ./zdtest continent/city time_t time_t\n\
 	zdump(argv[1], atol(argv[2]), atol(argv[3]), &num_entries, &data);
 	printf("number of entries found = %d\n", num_entries);
 	zd = data;
-	lazy_tz[0] = ':';
-	strncat(&lazy_tz[1],argv[1],999	);
-	setenv("TZ",&lazy_tz[0],1);
 	printf("for zone: %s, for time_t %ld to %ld\n",argv[1],atol(argv[2]), atol(argv[3]));
 	printf( "num:   time_t      utc_offset  save_secs abbr  - local time (derived) -\n");
 	for (i=0; i<num_entries; i++)
 	{
-		time_t local = zd->start + zd->utc_offset;
-		printf( "%2d: %11ld %10d %10d    %-6s %s", i, zd->start, zd->utc_offset, zd->save_secs, zd->abbr, ctime(&local) );
+		zdfmt_entry(local_buffer, sizeof(local_buffer), ZDFMT_ASCTIME, zd);
+		printf( "%2d: %11ld %10d %10d    %-6s %s\n", i, zd->start, zd->utc_offset, zd->save_secs, zd->abbr, local_buffer );
 		zd = zd + 1;
 	}
 	free(data);
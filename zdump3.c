@@ -25,36 +25,22 @@
 #define _GNU_SOURCE     /// feature_test_macro - for memmem
 #define _POSIX_C_SOURCE 1
 #include <time.h>		/// for time, ctime
-#include <stdlib.h>		/// for getenv
+#include <stdlib.h>		/// for getenv, realpath
 #include <unistd.h>		/// for getcwd, fstat
 #include <stdio.h>		/// for fopen, fileno
 #include <sys/types.h>	/// for fstat
 #include <sys/stat.h>	/// for fstat
 #include <unistd.h>		/// for fstat
 #include <string.h> 	/// for memcpy
+#include <dirent.h>		/// for opendir, readdir
 
-#define ZD_SUCCESS  0
-#define ZD_FAILURE -1
-#define ZD_BAD_VALUES  5001 /** time_t start > time_t end */
-#define ZD_DIR_PATH    5002 /** path to zonetab directory not found */
-#define ZD_FOPEN       5003 /** file not found */
-#define ZD_FREAD       5004 /** unable to read file */
-#define ZD_MALLOC      5005 /** memory allocation error */
-#define ZD_TZIF_HEADER 5006 /** unable to parse tzif header */
+#include "zdump3.h"
+#include "zdcache.h"		/// for zdcache_find
+#include "zdnames.h"		/// for zdnames_find
 
-#define NUMERIC "-123456789"
-#define TIMERIC "-123456789:"
-#define NOTABBR "-123456789:,"
-
- 
-/// zdumpinfo - an element of the array to return
-#define MAX_TZ_ABBR_SIZE   10  /// safe
-typedef struct {
-	time_t	start;    	/// seconds from epoch
-	int		utc_offset;	/// in seconds
-	int		save_secs;	/// (0 if not dst)
-	char	abbr[MAX_TZ_ABBR_SIZE]; /// terminate with '\0'
-	} zdumpinfo;
+#define NUMERIC "+-0123456789"
+#define TIMERIC "+-0123456789:"
+#define NOTABBR "+-0123456789:,"
 
 /// timezonefileheader - exists in one or two parts of a tzif file
 /// refer to 'man 5 tzfile' for structure of the TZif file
@@ -71,32 +57,19 @@ typedef struct {
 	} timezonefileheader;
 #define TZIF1_FIELD_SIZE 4
 #define TZIF2_FIELD_SIZE 8
-static char *local_time_type_ptr, *ttinfo_ptr, *tz_abbrev_ptr;
 #define SIZE_OF_TTINFO 6
 
 
-/// posix rule details
-typedef struct {
-	char type[2];
-	char abbr[2][MAX_TZ_ABBR_SIZE];
-	int j[2];
-	int m[2];
-	int w[2];
-	int d[2];
-	int offset[2];
-	int start_time[2];
-	int hour[2];
-	int min[2];
-	int sec[2];
-	int has_dst;
-	int save_secs[2];
-	} rule_detail;
+/// posix rule details - rule_detail is defined in zdump3.h
 #define STD 0
 #define DST 1
 #define DEFAULT_START_TIME 2 * 60 * 60
 #define DEFAULT_START_HOUR 2
 #define DEFAULT_START_MIN  0
 #define DEFAULT_START_SEC  0
+#define DEFAULT_DST_RULE   "M3.2.0,M11.1.0" /// as glibc, when none is given
+#define MAX_RULE_SIZE      256
+#define SECS_PER_DAY       86400
 
 
 #define BUFFER_INCREMENT 3  /// safe for a single year
@@ -161,60 +134,43 @@ int read_tz_header( timezonefileheader *header,  const char *temp_buffer)
 	header->timecnt = flip_tz_long(&temp_buffer[32], field_size);
 	header->typecnt = flip_tz_long(&temp_buffer[36], field_size);
 	header->charcnt = flip_tz_long(&temp_buffer[40], field_size);
-	if ( (header->typecnt == 0) || (header->timecnt == 0) ) return 0;
+	if (header->typecnt == 0) return 0;
 	return 1;
 }
 
-void add_a_rule_entry( const time_t start, void* return_data, int* num_entries,
-                       const int utc_offset, const int save_secs, const char* abbr)
-{
-	zdumpinfo* zd;
-	zd = (zdumpinfo*) return_data + *num_entries;
-	zd->start = start;
-	zd->utc_offset = utc_offset;
-	zd->save_secs = save_secs;
-	strncpy( zd->abbr, abbr, MAX_TZ_ABBR_SIZE);
-	*num_entries = *num_entries + 1;
-}
-
-void add_a_tzif_entry( const int i, const time_t start, void* return_data, int* num_entries )
+static unsigned long long tzif_block_size( const timezonefileheader* tzh,
+										   const unsigned int field_size )
 {
-	char* endptr;
-	int local_time_offset = local_time_type_ptr[i] * SIZE_OF_TTINFO;
-	char* tzabbr;
-	zdumpinfo* zd;
-	int prior_local_time_offset;
-
-	zd = (zdumpinfo*) return_data + *num_entries;
-	zd->start = start;
-	zd->utc_offset = (int) flip_tz_long( ttinfo_ptr + local_time_offset, 4);
-	zd->save_secs = 0;
-	if ((i != 0) && (ttinfo_ptr[ local_time_offset + 4 ]))
-	{
-		prior_local_time_offset = local_time_type_ptr[i-1] * SIZE_OF_TTINFO;
-		zd->save_secs = abs( zd->utc_offset
-						- ((int) flip_tz_long( ttinfo_ptr + prior_local_time_offset, 4)) );
-	}
-	tzabbr = &tz_abbrev_ptr[ (int) ttinfo_ptr[ local_time_offset + 5 ] ];
-	endptr = mempcpy( zd->abbr, tzabbr, strlen(tzabbr) );
-	memset( endptr, '\0', 1);
-	*num_entries = *num_entries + 1;
+	/// length of the data block following a header; leap second records
+	/// are a transition time and a four byte correction
+	return ((unsigned long long) tzh->timecnt * (field_size + 1)) +
+		   ((unsigned long long) tzh->typecnt * SIZE_OF_TTINFO) + tzh->charcnt +
+		   ((unsigned long long) tzh->leapcnt * (field_size + 4)) +
+		   tzh->ttisstdcnt + tzh->ttisgmtcnt;
 }
 
 int get_time( char *strptr, int *hour, int *min, int *sec )
 {
 	int fields_found = 0;
-	int sign;
+	int sign = 1;
 
-	fields_found = sscanf(strptr, "%i:%i:%i", hour, min, sec);
+	if (*strptr == '-') sign = -1;
+	if ((*strptr == '-') || (*strptr == '+')) strptr++;
+	fields_found = sscanf(strptr, "%d:%d:%d", hour, min, sec);
 	switch (fields_found)
 	{
+	case EOF:
 	case 0: *hour = DEFAULT_START_HOUR;
 	case 1: *min = DEFAULT_START_MIN;
 	case 2: *sec = DEFAULT_START_SEC;
 	}
-	sign = *hour < 0 ? -1 : 1;
-	return (*hour * 3600) + (sign * ((*min * 60) + *sec));
+	/// fields beyond any valid rule are held there for rule_valid() to
+	/// reject, rather than overflowing here
+	if ((*hour > 9999) || (*hour < -9999)) *hour = 9999;
+	if ((*min > 9999) || (*min < -9999)) *min = 9999;
+	if ((*sec > 9999) || (*sec < -9999)) *sec = 9999;
+	*hour = sign * *hour;
+	return sign * ((abs(*hour) * 3600) + (*min * 60) + *sec);
 }
 
 char* rule_julian( int i, char* next, rule_detail* p_rule )
@@ -223,14 +179,19 @@ char* rule_julian( int i, char* next, rule_detail* p_rule )
 	int  len = 0;
 	
 
-	next++;
-	p_rule->type[i] = 'J';
+	/// 'Jn' counts 1-365 and never Feb 29; a bare 'n' counts 0-365
+	if (*next == 'J')
+	{
+		next++;
+		p_rule->type[i] = 'J';
+	}
+	else p_rule->type[i] = 'N';
 	len = strspn(next, NUMERIC);
-	if (len > 3) return NULL;
+	if ((len == 0) || (len > 3)) return NULL;
 	memcpy(&julian, next, len);
 	memset(&julian[len],'\0',1);
 	p_rule->j[i] = atoi( (char*) &julian);
-	j_to_md(p_rule->j[i], &p_rule->m[i], &p_rule->d[i]);
+	if (p_rule->type[i] == 'J') j_to_md(p_rule->j[i], &p_rule->m[i], &p_rule->d[i]);
 	next += len;
 	if (*next == '/') p_rule->start_time[i] = get_time(next+1, 
 									&p_rule->hour[i], &p_rule->min[i], &p_rule->sec[i]);
@@ -249,8 +210,8 @@ char* rule_mwd( int i, char* next, rule_detail* p_rule )
 	char *next_time  = NULL;
 	p_rule->type[i] = 'M';
 	next++;
-	// maybe error-check for 3 values read in sscanf?
-	sscanf(next, "%i.%i.%i", &p_rule->m[i], &p_rule->w[i], &p_rule->d[i]);
+	if (sscanf(next, "%d.%d.%d", &p_rule->m[i], &p_rule->w[i], &p_rule->d[i]) != 3)
+		return NULL;
 	next_time = strchr( next, '/' );
 	next      = strchr( next, ',' );
 	if ((next_time != NULL) && ((next == NULL) || (next_time < next)))
@@ -268,50 +229,67 @@ char* rule_mwd( int i, char* next, rule_detail* p_rule )
 	return next;
 }
 
-int rule_decode( const char* tzif, const size_t tzif_size, rule_detail* p_rule )
+char* rule_abbr( char* next, char* abbr )
 {
-	char *rule_string = NULL;
-	int  rule_len;
-	char *next = NULL;
+	/// either alphabetic, or <quoted> and then possibly numeric (eg. <+03>)
+	size_t len;
+	char* abbr_ptr = next;
+
+	if (*next == '<')
+	{
+		abbr_ptr++;
+		len = strcspn(abbr_ptr, ">");
+		if (abbr_ptr[len] != '>') return NULL;
+		next = abbr_ptr + len + 1;
+	}
+	else
+	{
+		len = strcspn(next, NOTABBR);
+		next += len;
+	}
+	if (len == 0) return NULL;
+	if (len >= MAX_TZ_ABBR_SIZE) len = MAX_TZ_ABBR_SIZE - 1;
+	memcpy(abbr, abbr_ptr, len);
+	abbr[len] = '\0';
+	return next;
+}
+
+int rule_parse( char* rule_string, rule_detail* p_rule )
+{
+	/// parse a POSIX TZ string, eg. "EST5EDT,M3.2.0,M11.1.0", see 'man 3 tzset'
+	char *next = rule_string;
+	char default_rule[] = DEFAULT_DST_RULE;
 	int  len = 0;
 	int  offset_hour, offset_min, offset_sec;
+	int  i;
 
-	// consider error checking and bounds checking
-	// don't depend on it being a valid file
-	if ( tzif[tzif_size] == '\x0a' ) return ZD_FAILURE;
-	rule_string = memrchr( tzif, '\x0a', tzif_size);
-	if (rule_string == NULL) return ZD_FAILURE;
-	rule_string++;
-	next = rule_string;
-	setenv("TZ",rule_string,1);
-	rule_len = strlen(rule_string);
-	if (rule_len == 0) return ZD_FAILURE;
 	memset(p_rule,'\0',sizeof(rule_detail));
-	len = strcspn(rule_string, NUMERIC);
-	memcpy(p_rule->abbr[STD], rule_string, len);
-	next += len;
+	next = rule_abbr(next, p_rule->abbr[STD]);
+	if (next == NULL) return ZD_FAILURE;
 	len = strspn(next, TIMERIC);
+	if (len == 0) return ZD_FAILURE;
 	p_rule->offset[STD] = get_time( next, &offset_hour, &offset_min, &offset_sec );
 	next +=  len;
-	if ( next != (rule_string + rule_len -1) )
+	if ( *next != '\0' )
 	{
 		p_rule->has_dst = 1;
-		len = strcspn(next, NOTABBR);
-		memcpy(p_rule->abbr[DST], next, len);
-		next += len;
+		next = rule_abbr(next, p_rule->abbr[DST]);
+		if (next == NULL) return ZD_FAILURE;
 		len = strspn(next, TIMERIC);
-		if (len == 0) p_rule->offset[DST] = p_rule->offset[STD] + 3600;
+		/// POSIX offsets are west of UTC, so DST defaults to one hour less
+		if (len == 0) p_rule->offset[DST] = p_rule->offset[STD] - 3600;
 		else p_rule->offset[DST] = get_time( next, &offset_hour, &offset_min, &offset_sec );
 		next += len;
 		p_rule->save_secs[STD] = abs(p_rule->offset[DST] - p_rule->offset[STD]);
-		next++;
-		if (*next == 'J') next = rule_julian(STD, next, p_rule);
-		else next = rule_mwd(STD, next, p_rule);
-		if (*next == ',')
+		if (*next == '\0') next = default_rule;
+		else if (*next == ',') next++;
+		else return ZD_FAILURE;
+		for (i=STD; i<=DST; i++)
 		{
-			next++;
-			if (*next == 'J') next = rule_julian(DST, next, p_rule);
-			else next = rule_mwd(DST, next, p_rule);
+			if (next == NULL) return ZD_FAILURE;
+			if (*next == 'M') next = rule_mwd(i, next, p_rule);
+			else next = rule_julian(i, next, p_rule);
+			if ((i == STD) && (next != NULL)) next++;
 		}
 	}
 /** DEBUG
@@ -325,122 +303,191 @@ p_rule->offset[1], p_rule->start_time[1], p_rule->hour[1], p_rule->min[1], p_rul
 );
 exit(0);
 */
+
 	return ZD_SUCCESS;
 }
 
-void init_tm_struct( struct tm *tmx )
+int tzif_footer( const char* footer, const size_t footer_size, char* rule_string )
 {
-		tmx->tm_sec = 0;
-		tmx->tm_min = 0;
-		tmx->tm_hour = 0;
-		tmx->tm_mday = 0;
-		tmx->tm_mon = 0;
-		tmx->tm_year = 0;
-		tmx->tm_wday = 0;
-		tmx->tm_yday = 0;
-		tmx->tm_isdst = 0;
+	/// copy the newline-enclosed POSIX TZ string that follows the data of
+	/// a version 2 or later TZif file into rule_string, which holds
+	/// MAX_RULE_SIZE characters. The footer may be empty ("\n\n").
+	const char* rule_start;
+	const char* rule_end;
+	size_t rule_len;
+
+	if ((footer_size < 2) || (footer[0] != '\x0a')) return ZD_FAILURE;
+	rule_start = &footer[1];
+	rule_end = memchr( rule_start, '\x0a', footer_size - 1 );
+	if (rule_end == NULL) return ZD_FAILURE;
+	rule_len = rule_end - rule_start;
+	if ((rule_len == 0) || (rule_len >= MAX_RULE_SIZE)) return ZD_FAILURE;
+	memcpy(rule_string, rule_start, rule_len);
+	rule_string[rule_len] = '\0';
+	return ZD_SUCCESS;
 }
 
-int utc_seconds( const struct tm *tmx )
+int rule_decode( const char* footer, const size_t footer_size, rule_detail* p_rule )
 {
-	return tmx->tm_sec + (tmx->tm_min * 60) + (tmx->tm_hour * 3600);
+	char rule_string[MAX_RULE_SIZE];
+
+	if (tzif_footer( footer, footer_size, rule_string ) == ZD_FAILURE) return ZD_FAILURE;
+	return rule_parse( rule_string, p_rule );
 }
 
-int rule_dump( const char* tzif, const size_t tzif_size,
-					  const time_t start, const time_t end, time_t current,
-					  int* num_entries, void** return_data, size_t *ret_buff_size)
+static int tzif_path( char* tzname, char* path )
 {
-	rule_detail p_rule;
-	time_t prior;
-	struct tm tm_local, tm_gmt, tm_prior;
-	int utc_offset;
-	int save_secs;
-	zdumpinfo* zd;
+	/// the file of 'tzname', into 'path' of PATH_MAX. Relative names are
+	/// found in the name index in use, if any, with no search of the
+	/// zoneinfo directories; names it lacks (eg. right/UTC, localtime),
+	/// and all names without one, are joined to the zoneinfo directory
+	/// rather than chdir()ing to it, so that concurrent callers (eg.
+	/// zdump_prefetch) do not race on the process's working directory
+	char* tzdir     = NULL;	/// system base timezone directory
+	char* tzdirlist[2] = { "/usr/share/zoneinfo/",	/// libc >= 5.4.6
+						   "/usr/lib/zoneinfo/" };	/// libc <  5.4.6
+	char* localtime_name = "localtime";
+	struct stat file_status;
+	const zdnames* names = zdnames_in_use();
 	int i;
 
-// Should I make this a little simpler by using the glibc version
-// of struct tm which has additional fields:
-//  long tm_gmtoff;           /* Seconds east of UTC */
-//  const char *tm_zone;      /* Timezone abbreviation */
-// returned by gmtime_r localtime_r
-	if (rule_decode( tzif, tzif_size, &p_rule ) == ZD_FAILURE) return ZD_FAILURE;
-	init_tm_struct(&tm_local);
-	init_tm_struct(&tm_gmt);
-	if (current < start)
-	{
-		// We really should try to be totally independant of
-		// these two functions localtime_r() and gmtime_r()
-		localtime_r(&start, &tm_local);
-		gmtime_r(&start, &tm_gmt);
-		utc_offset = utc_seconds(&tm_local) - utc_seconds(&tm_gmt);
-		// FIXME - account for possibility of initial transition being
-		// from standard to standard or DST to DST, with different offsets
-		if (tm_local.tm_isdst <= 0) save_secs = tm_local.tm_isdst;
-		else
-		{
-			localtime_r(&current, &tm_prior);
-			gmtime_r(&current, &tm_gmt);
-			save_secs = abs(utc_offset
-						- (utc_seconds(&tm_prior) - utc_seconds(&tm_gmt)) );
-		}
-		if ( !( *num_entries%BUFFER_INCREMENT) )
+	if ((names != NULL) && (tzname != NULL) && (tzname[0] != '/'))
+	{
+		i = zdnames_find( names, tzname );
+		if (i >= 0)
 		{
-			*return_data = perform_a_realloc(*return_data, ret_buff_size);
-			if (*return_data == NULL) return ZD_FAILURE;
+			if (snprintf( path, PATH_MAX, "%s/%s", names->tzdir, names->names[i].name ) >= PATH_MAX)
+				return ZD_FOPEN;
+			return ZD_SUCCESS;
 		}
-		add_a_rule_entry( start, *return_data, num_entries, utc_offset, save_secs, tm_local.tm_zone );
-		if (!p_rule.has_dst) return ZD_SUCCESS;
-		memcpy( (char*) &tm_prior, (char*) &tm_local, sizeof(struct tm));
 	}
-	else
+	tzdir = getenv("TZDIR");
+	if ((tzdir == NULL) || stat( tzdir, &file_status ) || !S_ISDIR(file_status.st_mode))
+		tzdir = tzdirlist[0];
+	if (stat( tzdir, &file_status ) || !S_ISDIR(file_status.st_mode))
+		tzdir = tzdirlist[1];
+	if (stat( tzdir, &file_status ) || !S_ISDIR(file_status.st_mode))
+		return ZD_DIR_PATH;
+	if (tzname == NULL) tzname = localtime_name;
+	if (tzname[0] == '/')
+	{
+		if (strlen(tzname) >= PATH_MAX) return ZD_FOPEN;
+		strcpy( path, tzname );
+	}
+	else if (snprintf( path, PATH_MAX, "%s/%s", tzdir, tzname ) >= PATH_MAX) return ZD_FOPEN;
+	return ZD_SUCCESS;
+}
+
+int tzif_read( char* tzname, char** tzif, size_t* tzif_size )
+{
+	/// read an entire TZif file into a malloc()ed buffer
+	char path[PATH_MAX];
+	struct stat file_status;
+	FILE *tz_file = NULL;
+	int result;
+
+	*tzif = NULL;
+	*tzif_size = 0;
+	result = tzif_path( tzname, path );
+	if (result != ZD_SUCCESS) return result;
+	tz_file = fopen(path, "rb");
+	if (tz_file == NULL) {result= ZD_FOPEN; goto endpoint;};
+	if (fstat( fileno(tz_file), &file_status) != 0) {result= ZD_FREAD; goto endpoint;};
+	*tzif = malloc( file_status.st_size );
+	if (*tzif == NULL)  {result= ZD_MALLOC; goto endpoint;};
+	if (fread( *tzif, file_status.st_size, 1, tz_file) != 1 )  {result= ZD_FREAD; goto endpoint;};
+	*tzif_size = file_status.st_size;
+endpoint:
+	if (tz_file != NULL) fclose(tz_file);
+	if ((result != ZD_SUCCESS) && (*tzif != NULL))
 	{
-		zd = (zdumpinfo*) *return_data + (*num_entries - 1);
-		prior = zd->start;
-		localtime_r(&prior, &tm_prior);
+		free(*tzif);
+		*tzif = NULL;
 	}
-	if ((!tm_prior.tm_isdst) && (!p_rule.has_dst)) return ZD_SUCCESS;
-	i = tm_prior.tm_isdst > 0 ? 1 : 0;
-	while (1)
+	return result;
+}
+
+int tzif_data( char* tzif, const size_t tzif_size, timezonefileheader* tzh,
+			   unsigned int* field_size, char** data )
+{
+	/// locate the data block to be parsed: for a version 2, 3 or 4 file,
+	/// the 64-bit block following the second header, whose offset follows
+	/// from the counts of the first; otherwise the 32-bit block. Fails
+	/// with ZD_TZIF_TRUNC unless the whole block lies within the file.
+	size_t offset = HEADER_LEN;
+	char version;
+
+	*data = NULL;
+	if (tzif_size < HEADER_LEN) return ZD_TZIF_TRUNC;
+	if (memcmp( tzif, "TZif", 4 )) return ZD_TZIF_HEADER;
+	version = tzif[4];
+	if ((version != '\0') && ((version < '2') || (version > '4'))) return ZD_TZIF_HEADER;
+	if (!read_tz_header( tzh, tzif )) return ZD_TZIF_HEADER;
+	*field_size = TZIF1_FIELD_SIZE;
+	if (version != '\0')
+	{
+		if (tzif_block_size( tzh, TZIF1_FIELD_SIZE ) + HEADER_LEN > tzif_size - offset)
+			return ZD_TZIF_TRUNC;
+		offset += tzif_block_size( tzh, TZIF1_FIELD_SIZE );
+		if (memcmp( &tzif[offset], tzif, 5 )) return ZD_TZIF_HEADER;
+		if (!read_tz_header( tzh, &tzif[offset] )) return ZD_TZIF_HEADER;
+		*field_size = TZIF2_FIELD_SIZE;
+		offset += HEADER_LEN;
+	}
+	if (tzif_block_size( tzh, *field_size ) > tzif_size - offset) return ZD_TZIF_TRUNC;
+	*data = &tzif[offset];
+	return ZD_SUCCESS;
+}
+
+
+static int zone_get( char* tzname, const zdzone** zone, zdzone** loaded )
+{
+	/// the cached zone, else one parsed now into *loaded. A bounded cache
+	/// is given the zones parsed, as is any cache while a name index is
+	/// in use, so that a name is read from disk once; an unbounded cache
+	/// otherwise is not.
+	zdcache_stats usage;
+	int result;
+
+	*loaded = NULL;
+	*zone = zdcache_find(tzname);
+	if (*zone != NULL) return ZD_SUCCESS;
+	zdcache_usage(&usage);
+	if (usage.limit || (zdnames_in_use() != NULL)) return zdcache_get( tzname, zone );
+	result = zdzone_load( tzname, loaded );
+	*zone = *loaded;
+	return result;
+}
+
+static int zone_dump( const zdzone* zone, const time_t start, const time_t end,
+					  int* num_entries, void** return_data )
+{
+	/// fill zdump()'s return_data from a parsed zone
+	zditer iter;
+	zdumpinfo entry;
+	size_t ret_buff_size = 0;
+	int result = ZD_SUCCESS;
+
+	zditer_init( &iter, zone, start, end );
+	while (zditer_next( &iter, &entry ))
 	{
-		tm_local.tm_hour = p_rule.hour[i];
-		tm_local.tm_min  = p_rule.min[i];
-		tm_local.tm_sec  = p_rule.sec[i];
-		switch (p_rule.type[i])
-		{
-		case 'M':
-			tm_local.tm_mday = 1;
-			tm_local.tm_mon = p_rule.m[i] - 1;
-			if ( tm_prior.tm_mon < tm_local.tm_mon ) tm_local.tm_year = tm_prior.tm_year;
-			else tm_local.tm_year = tm_prior.tm_year + 1;
-			current = mktime(&tm_local);
-			tm_local.tm_mday = ((p_rule.w[i]-1)*7) + p_rule.d[i] + 1 + (7 - tm_local.tm_wday);
-			break;
-		case 'J':
-			if ( tm_prior.tm_yday < p_rule.j[i] ) tm_local.tm_year = tm_prior.tm_year;
-			else tm_local.tm_year = tm_prior.tm_year + 1;
-			tm_local.tm_mday  = p_rule.j[i];
-			tm_local.tm_mon  = 0;
-			break;
-		default: return ZD_FAILURE; break;
-		}
-		current = mktime(&tm_local);
-		if (current > end) break;
 		if ( !( *num_entries%BUFFER_INCREMENT) )
 		{
-			*return_data = perform_a_realloc(*return_data, ret_buff_size);
-			if (*return_data == NULL) return ZD_FAILURE;
+			*return_data = perform_a_realloc(*return_data, &ret_buff_size);
+			if (*return_data == NULL) {result= ZD_MALLOC; *num_entries = 0; break;};
 		}
-		add_a_rule_entry( current, *return_data, num_entries, tm_local.tm_gmtoff,
-							p_rule.save_secs[i], tm_local.tm_zone );
-		// this next is only for the first pass
-		if (!p_rule.has_dst) return ZD_SUCCESS;
-		memcpy( (char*) &tm_prior, (char*) &tm_local, sizeof(struct tm));
-		i = i > 0 ? 0 : 1;
+		((zdumpinfo*) *return_data)[*num_entries] = entry;
+		*num_entries = *num_entries + 1;
 	}
-	return ZD_SUCCESS;
+	if (!(*num_entries))
+	{
+		if (*return_data != NULL) free(*return_data);
+		*return_data = NULL;
+		if (result == ZD_SUCCESS) result = ZD_FAILURE;
+	}
+	return result;
 }
 
-
 int zdump(               /// returns 0 on ZD_SUCCESS, -1 on ZD_FAILURE
     char* tzname,        /// fully-qualified time-zone name (eg. Asia/Baku)
                          ///    if NULL, use current system timezone
@@ -459,93 +506,954 @@ int zdump(               /// returns 0 on ZD_SUCCESS, -1 on ZD_FAILURE
           )
 {
 // TODO - report errors and set errno
-	char* startdir = NULL;	/// current working directory on entry to this function
-	char* tzdir     = NULL;	/// system base timezone directory
-	char* tzdirlist[2] = { "/usr/share/zoneinfo/",	/// libc >= 5.4.6
-						   "/usr/lib/zoneinfo/" };	/// libc <  5.4.6
-	char* localtime_name = "localtime";
-	struct stat file_status;
+	zdzone* loaded;			/// tz file parsed into memory here
+	const zdzone* zone;		/// that, or the cached zone
+	int result;
+
+	*num_entries = 0;
+	if (end < start) return ZD_BAD_VALUES;
+	result = zone_get( tzname, &zone, &loaded );
+	if (result != ZD_SUCCESS) return result;
+	result = zone_dump( zone, start, end, num_entries, return_data );
+/// cleanup and exit
+	if (loaded != NULL) zdzone_free(loaded);
+	else zdcache_put(zone);
+	return result;
+}
+
+int zdump_posix( const char* tz, const time_t start, const time_t end,
+				 int* num_entries, void** return_data )
+{
+	const zdzone* zone;
+	int result;
+
+	*num_entries = 0;
+	if (end < start) return ZD_BAD_VALUES;
+	result = zdcache_posix( tz, &zone );
+	if (result != ZD_SUCCESS) return result;
+	result = zone_dump( zone, start, end, num_entries, return_data );
+	zdcache_put(zone);
+	return result;
+}
+
+
+/// civil calendar arithmetic, proleptic Gregorian, independent of libc
+/// and of the TZ environment variable
+static int is_leap_year( const long year )
+{
+	return (!(year % 4) && (year % 100)) || !(year % 400);
+}
+
+static int days_in_month( const long year, const int month )
+{
+	static const int mdays[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
+	return mdays[month-1] + ((month == 2) && is_leap_year(year));
+}
+
+static long days_from_civil( long year, const int month, const int day )
+{
+	/// days since 1970-01-01 for year, month 1-12, day 1-31
+	long era;
+	long yoe, doy, doe;
+
+	year -= (month <= 2);
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - (era * 400);
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	return (era * 146097) + doe - 719468;
+}
+
+static long days_of_time( const time_t t )
+{
+	/// days since 1970-01-01, rounding toward the past
+	long days = t / SECS_PER_DAY;
+	if ((t % SECS_PER_DAY) < 0) days--;
+	return days;
+}
+
+static void civil_from_days( long days, long* year, int* month, int* day )
+{
+	long era, doe, yoe, doy, mp;
+
+	days += 719468;
+	era = (days >= 0 ? days : days - 146096) / 146097;
+	doe = days - (era * 146097);
+	yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+	doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+	mp = ((5 * doy) + 2) / 153;
+	*day = (int) (doy - (((153 * mp) + 2) / 5) + 1);
+	*month = (int) (mp < 10 ? mp + 3 : mp - 9);
+	*year = yoe + (era * 400) + (*month <= 2);
+}
+
+static long year_of_time( const time_t t )
+{
+	long year;
+	int month, day;
+
+	civil_from_days( days_of_time(t), &year, &month, &day );
+	return year;
+}
+
+
+time_t rule_edge( const rule_detail* p_rule, const long year, const int i )
+{
+	/// the UTC time at which rule 'i' takes effect in 'year'. The change
+	/// into DST is stated in standard time, the change out of it in DST.
+	long day;
+	int  wday, mday;
+
+	switch (p_rule->type[i])
+	{
+	case 'J':
+		day = days_from_civil(year, 1, 1) + p_rule->j[i] - 1;
+		if ((p_rule->j[i] >= 60) && is_leap_year(year)) day++;
+		break;
+	case 'N':
+		day = days_from_civil(year, 1, 1) + p_rule->j[i];
+		break;
+	default:
+		day = days_from_civil(year, p_rule->m[i], 1);
+		wday = (int) (((day % 7) + 11) % 7);   /// 1970-01-01 was a Thursday
+		mday = 1 + ((p_rule->d[i] - wday + 7) % 7) + ((p_rule->w[i] - 1) * 7);
+		while (mday > days_in_month(year, p_rule->m[i])) mday -= 7;
+		day = day + mday - 1;
+		break;
+	}
+	return (time_t) day * SECS_PER_DAY + p_rule->start_time[i]
+			+ p_rule->offset[ i == STD ? STD : DST ];
+}
+
+static int rule_edge_pos( const rule_detail* p_rule, const long year, const int pos,
+						  time_t* when )
+{
+	/// the pos'th (0 or 1) rule edge of 'year' in chronological order.
+	/// returns which rule it is. The edges of a year beyond ZD_YEAR_MIN to
+	/// ZD_YEAR_MAX, which do not fit in a time_t, are ZD_TIME_MIN or
+	/// ZD_TIME_MAX, in the order of the nearest year that fits
+	time_t edge[2];
+	long   fits = year < ZD_YEAR_MIN ? ZD_YEAR_MIN : (year > ZD_YEAR_MAX ? ZD_YEAR_MAX : year);
+	int    first;
+
+	edge[STD] = rule_edge(p_rule, fits, STD);
+	edge[DST] = rule_edge(p_rule, fits, DST);
+	first = edge[STD] <= edge[DST] ? STD : DST;
+	*when = edge[ pos ? !first : first ];
+	if (year != fits) *when = year < fits ? ZD_TIME_MIN : ZD_TIME_MAX;
+	return pos ? !first : first;
+}
+
+static time_t rule_after( const rule_detail* p_rule, const time_t t,
+						  long* year, int* pos )
+{
+	/// find the first rule edge strictly after t; ZD_TIME_MAX, at the
+	/// first edge beyond ZD_YEAR_MAX, when there is none that fits
+	time_t when;
+
+	*year = year_of_time(t) - 1;
+	if (*year < ZD_YEAR_MIN - 1) *year = ZD_YEAR_MIN - 1;
+	*pos = 0;
+	while (*year <= ZD_YEAR_MAX)
+	{
+		rule_edge_pos(p_rule, *year, *pos, &when);
+		if (when > t) return when;
+		if (*pos) (*year)++;
+		*pos = !(*pos);
+	}
+	return ZD_TIME_MAX;
+}
+
+static void rule_info( const rule_detail* p_rule, const int i, const time_t start,
+					   zdumpinfo* zd )
+{
+	/// the state that rule 'i' puts into effect
+	zd->start = start;
+	zd->utc_offset = -p_rule->offset[ i == STD ? DST : STD ];
+	zd->save_secs = i == STD ? p_rule->save_secs[STD] : 0;
+	memcpy( zd->abbr, p_rule->abbr[ i == STD ? DST : STD ], MAX_TZ_ABBR_SIZE);
+}
+
+static void ttinfo_info( const zdzone* zone, const int type, const int save_secs,
+						 const time_t start, zdumpinfo* zd )
+{
+	zd->start = start;
+	zd->utc_offset = zone->ttinfo[type].utc_offset;
+	zd->save_secs = save_secs;
+	memcpy( zd->abbr, zone->ttinfo[type].abbr, MAX_TZ_ABBR_SIZE);
+}
+
+
+static void zone_fixed( zdzone* zone )
+{
+	/// detect, once, a zone that is one local time type at all times (eg.
+	/// UTC, Etc/GMT+5), for zdzone_span() to answer without any search
+	if (zone->timecnt || (zone->has_rule && zone->rule.has_dst)) return;
+	zone->is_fixed = 1;
+	if (zone->has_rule) rule_info( &zone->rule, DST, ZD_TIME_MIN, &zone->fixed );
+	else ttinfo_info( zone, 0, 0, ZD_TIME_MIN, &zone->fixed );
+}
+
+static int rule_valid( const rule_detail* p_rule )
+{
+	/// bounds, as RFC 8536, on what a TZ string from outside (a TZif
+	/// footer, or one given to zdzone_posix) may hold, so that rule_edge()
+	/// is never asked for a 13th month
+	int i;
+
+	for (i=STD; i<=DST; i++)
+		if (abs(p_rule->offset[i]) > 25 * 3600) return 0;
+	if (!p_rule->has_dst) return 1;
+	for (i=STD; i<=DST; i++)
+	{
+		if ((abs(p_rule->hour[i]) > 167) || (p_rule->min[i] < 0) || (p_rule->min[i] > 59) ||
+			(p_rule->sec[i] < 0) || (p_rule->sec[i] > 59) ||
+			(abs(p_rule->start_time[i]) > 167 * 3600)) return 0;
+		switch (p_rule->type[i])
+		{
+		case 'J':
+			if ((p_rule->j[i] < 1) || (p_rule->j[i] > 365)) return 0;
+			break;
+		case 'N':
+			if ((p_rule->j[i] < 0) || (p_rule->j[i] > 365)) return 0;
+			break;
+		default:
+			if ((p_rule->m[i] < 1) || (p_rule->m[i] > 12) || (p_rule->w[i] < 1) ||
+				(p_rule->w[i] > 5) || (p_rule->d[i] < 0) || (p_rule->d[i] > 6))
+				return 0;
+			break;
+		}
+	}
+	return 1;
+}
+
+int zdzone_load( char* tzname, zdzone** zone )
+{
 	char* tzif = NULL;		/// tz file copied into memory here
+	size_t tzif_size;
 	timezonefileheader tzh;
 	char* start_ptr;		/// point in *tzif where we start to parse
+	char* footer;			/// the POSIX TZ string of a tzif2 (or later)
+	size_t footer_size;
 	unsigned int field_size;/// different for tzif and tzif2
-	FILE *tz_file;
+	char *type_ptr, *info_ptr, *abbr_ptr;
+	unsigned int abbr_index;
+	size_t abbr_len;
+	zdzone* zd = NULL;
+	int std_offset;
+	int has_std;
 	int result;
 	unsigned int i;
-	signed long temp_long;
-	size_t ret_buff_size = 0;
-	char *transition_time_ptr;
 
-	*num_entries = 0;
-	if (end < start) return ZD_BAD_VALUES;
-	startdir = getcwd( NULL, 0 );
-	tzdir = getenv("TZDIR");
-	result = ZD_DIR_PATH;
-	if (tzdir != NULL) result = chdir(tzdir);
-	if (result)        result = chdir(tzdirlist[0]);
-	if (result)        result = chdir(tzdirlist[1]);
-	if (result)        return ZD_DIR_PATH;
-	result = ZD_SUCCESS;
-	if (tzname == NULL) tzname = localtime_name;
-	tz_file = fopen(tzname, "rb");
-	if (tz_file == NULL) {result= ZD_FOPEN; goto endpoint;};
-	if (fstat( fileno(tz_file), &file_status) != 0) {result= ZD_FREAD; goto endpoint;};
-	tzif = malloc( file_status.st_size );
-	if (tzif == NULL)  {result= ZD_MALLOC; goto endpoint;};
-	if (fread( tzif, file_status.st_size, 1, tz_file) != 1 )  {result= ZD_FREAD; goto endpoint;};
-	fclose(tz_file);
-	if (!read_tz_header( &tzh, tzif)) {result= ZD_TZIF_HEADER; goto endpoint;};
-	if (tzh.magicnumber[4] == 50 )
-	{
-		start_ptr = memmem( &tzif[HEADER_LEN], file_status.st_size - HEADER_LEN, "TZif2", 5 );
-		if (start_ptr == NULL) {result= ZD_TZIF_HEADER; goto endpoint;};
-		if (read_tz_header( &tzh, start_ptr ) == ZD_FAILURE ) {result= ZD_TZIF_HEADER; goto endpoint;};
-		start_ptr = start_ptr + HEADER_LEN;
-		field_size = TZIF2_FIELD_SIZE;
-	}
-	else
+	*zone = NULL;
+	result = tzif_read( tzname, &tzif, &tzif_size );
+	if (result != ZD_SUCCESS) return result;
+	result = tzif_data( tzif, tzif_size, &tzh, &field_size, &start_ptr );
+	if (result != ZD_SUCCESS) goto endpoint;
+	footer = start_ptr + tzif_block_size( &tzh, field_size );
+
+	zd = calloc( 1, sizeof(zdzone) );
+	if (zd == NULL) {result= ZD_MALLOC; goto endpoint;};
+	zd->timecnt = tzh.timecnt;
+	zd->typecnt = tzh.typecnt;
+	zd->transitions = malloc( sizeof(time_t) * (tzh.timecnt + 1) );
+	zd->types = malloc( tzh.timecnt + 1 );
+	zd->save_secs = malloc( sizeof(int) * (tzh.timecnt + 1) );
+	zd->ttinfo = calloc( tzh.typecnt, sizeof(zdttinfo) );
+	if ((zd->transitions == NULL) || (zd->types == NULL) ||
+		(zd->save_secs == NULL) || (zd->ttinfo == NULL))
+		{result= ZD_MALLOC; goto endpoint;};
+
+	type_ptr = start_ptr + tzh.timecnt*field_size;
+	info_ptr = type_ptr + tzh.timecnt;
+	abbr_ptr = info_ptr + (tzh.typecnt * SIZE_OF_TTINFO);
+	for (i=0; i<tzh.typecnt; i++)
 	{
-		start_ptr = &tzif[HEADER_LEN];
-		field_size = TZIF1_FIELD_SIZE;
+		zd->ttinfo[i].utc_offset = (int) flip_tz_long( info_ptr, 4);
+		zd->ttinfo[i].is_dst = info_ptr[4];
+		abbr_index = (unsigned char) info_ptr[5];
+		if (abbr_index < tzh.charcnt)
+		{
+			abbr_len = strnlen( &abbr_ptr[abbr_index], tzh.charcnt - abbr_index );
+			if (abbr_len >= MAX_TZ_ABBR_SIZE) abbr_len = MAX_TZ_ABBR_SIZE - 1;
+			memcpy( zd->ttinfo[i].abbr, &abbr_ptr[abbr_index], abbr_len );
+		}
+		info_ptr = info_ptr + SIZE_OF_TTINFO;
 	}
 
-	transition_time_ptr = start_ptr;
-	local_time_type_ptr = start_ptr + tzh.timecnt*field_size;
-	ttinfo_ptr = local_time_type_ptr + tzh.timecnt;
-	tz_abbrev_ptr = ttinfo_ptr + (tzh.typecnt * 6);
-	// TODO - replace this incremental search with something more efficient
+	/// save_secs is measured from the most recent standard time
+	has_std = 0;
+	std_offset = 0;
+	for (i=0; i<tzh.typecnt; i++) if (!zd->ttinfo[i].is_dst)
+	{
+		std_offset = zd->ttinfo[i].utc_offset;
+		break;
+	}
 	for (i=0; i<tzh.timecnt; i++)
 	{
-		temp_long = flip_tz_long( transition_time_ptr, field_size );
-		if (temp_long >= start)
+		zd->transitions[i] = (time_t) flip_tz_long( start_ptr, field_size );
+		zd->types[i] = (unsigned char) type_ptr[i];
+		if (zd->types[i] >= tzh.typecnt) {result= ZD_TZIF_HEADER; goto endpoint;};
+		if (!zd->ttinfo[ zd->types[i] ].is_dst)
 		{
-			*return_data = perform_a_realloc(*return_data, &ret_buff_size);
-			if (*return_data == NULL) {result= ZD_MALLOC; goto endpoint;};
-			add_a_tzif_entry( i>0 ? i-1: 0, (time_t) start, *return_data, num_entries );
-			break;
+			has_std = 1;
+			std_offset = zd->ttinfo[ zd->types[i] ].utc_offset;
+			zd->save_secs[i] = 0;
 		}
-		transition_time_ptr = transition_time_ptr + field_size;
+		else if (has_std || (i == 0))
+			zd->save_secs[i] = abs( zd->ttinfo[ zd->types[i] ].utc_offset - std_offset );
+		else zd->save_secs[i] = zd->save_secs[i-1];
+		start_ptr = start_ptr + field_size;
 	}
-	while (i < tzh.timecnt)
+
+	if (field_size == TZIF2_FIELD_SIZE)
 	{
-		temp_long = flip_tz_long( transition_time_ptr, field_size );
-		if (temp_long > end) break;
-		if ( !( *num_entries%BUFFER_INCREMENT) ) *return_data = perform_a_realloc(*return_data, &ret_buff_size);
-		add_a_tzif_entry( i, (time_t) temp_long, *return_data, num_entries );
-		transition_time_ptr = transition_time_ptr + field_size;
-		i++;
+		/// the footer is required, though the TZ string in it may be empty
+		footer_size = &tzif[tzif_size] - footer;
+		if ((footer_size < 2) || (footer[0] != '\x0a') ||
+			(memchr( &footer[1], '\x0a', footer_size - 1 ) == NULL))
+			{result= ZD_TZIF_TRUNC; goto endpoint;};
+		if (rule_decode( footer, footer_size, &zd->rule ) == ZD_SUCCESS)
+		{
+			if (!rule_valid( &zd->rule )) {result= ZD_TZIF_HEADER; goto endpoint;};
+			zd->has_rule = 1;
+		}
 	}
-	if ((i == tzh.timecnt) && (temp_long < end))
-		result = rule_dump(tzif, file_status.st_size-2, start, end, (time_t) temp_long,
-						num_entries, return_data, &ret_buff_size);
+	zone_fixed(zd);
+
 /// cleanup and exit
 endpoint:
 	if (tzif != NULL) free(tzif);
-	chdir(startdir);
-	if (!(*num_entries))
+	if (result != ZD_SUCCESS) zdzone_free(zd);
+	else *zone = zd;
+	return result;
+}
+
+void zdzone_free( zdzone* zone )
+{
+	if (zone == NULL) return;
+	free(zone->transitions);
+	free(zone->types);
+	free(zone->save_secs);
+	free(zone->ttinfo);
+	free(zone);
+}
+
+int zdzone_posix( const char* tz, zdzone** zone )
+{
+	char rule_string[MAX_RULE_SIZE];
+	zdzone* zd;
+	int i;
+
+	*zone = NULL;
+	if ((tz == NULL) || (strlen(tz) >= MAX_RULE_SIZE)) return ZD_TZ_STRING;
+	strcpy( rule_string, tz );
+	zd = calloc( 1, sizeof(zdzone) );
+	if (zd == NULL) return ZD_MALLOC;
+	if ((rule_parse( rule_string, &zd->rule ) != ZD_SUCCESS) || !rule_valid( &zd->rule ))
 	{
-		if (*return_data != NULL) free(*return_data);
-		result = ZD_FAILURE;
+		free(zd);
+		return ZD_TZ_STRING;
+	}
+	zd->has_rule = 1;
+
+	/// a local time type each for standard time and DST, as zic would
+	/// write for a zone having only this rule
+	zd->typecnt = zd->rule.has_dst ? 2 : 1;
+	zd->ttinfo = calloc( zd->typecnt, sizeof(zdttinfo) );
+	if (zd->ttinfo == NULL)
+	{
+		free(zd);
+		return ZD_MALLOC;
+	}
+	for (i=STD; i<zd->typecnt; i++)
+	{
+		zd->ttinfo[i].utc_offset = -zd->rule.offset[i];
+		zd->ttinfo[i].is_dst = i == DST;
+		memcpy( zd->ttinfo[i].abbr, zd->rule.abbr[i], MAX_TZ_ABBR_SIZE );
+	}
+	zone_fixed(zd);
+	*zone = zd;
+	return ZD_SUCCESS;
+}
+
+size_t zdzone_size( const zdzone* zone )
+{
+	return sizeof(zdzone) +
+		   ((sizeof(time_t) + sizeof(unsigned char) + sizeof(int)) * zone->timecnt) +
+		   (sizeof(zdttinfo) * zone->typecnt);
+}
+
+
+static void transition_span( const zdzone* zone, const int i, zdspan* span )
+{
+	/// the interval beginning at explicit transition i
+	span->index = i;
+	span->lo = zone->transitions[i];
+	ttinfo_info( zone, zone->types[i], zone->save_secs[i], span->lo, &span->info );
+	if (i+1 < zone->timecnt) span->hi = zone->transitions[i+1];
+	else if (zone->has_rule && zone->rule.has_dst)
+		span->hi = rule_after( &zone->rule, span->lo, &span->year, &span->pos );
+	else span->hi = ZD_TIME_MAX;
+}
+
+void zdzone_span( const zdzone* zone, const time_t t, zdspan* span )
+{
+	int lo, hi, mid;
+	time_t last;
+	long year;
+	int  pos, i;
+
+	if (zone->is_fixed)
+	{
+		span->index = -1;
+		span->lo = ZD_TIME_MIN;
+		span->hi = ZD_TIME_MAX;
+		span->info = zone->fixed;
+		return;
+	}
+	if ((zone->timecnt > 0) && (t < zone->transitions[0]))
+	{
+		span->index = -1;
+		span->lo = ZD_TIME_MIN;
+		span->hi = zone->transitions[0];
+		ttinfo_info( zone, 0, 0, span->lo, &span->info );
+		return;
+	}
+	if (zone->timecnt > 0)
+	{
+		/// the last transition at or before t; most often, for times
+		/// near the present, the last of all
+		lo = 0;
+		hi = zone->timecnt - 1;
+		if (t >= zone->transitions[hi]) lo = hi;
+		while (lo < hi)
+		{
+			mid = lo + ((hi - lo + 1) / 2);
+			if (zone->transitions[mid] <= t) lo = mid;
+			else hi = mid - 1;
+		}
+		transition_span( zone, lo, span );
+		if ((t < span->hi) || (span->hi == ZD_TIME_MAX)) return;
+		last = zone->transitions[ zone->timecnt - 1 ];
+	}
+	else
+	{
+		last = ZD_TIME_MIN;
+		span->index = -1;
+		span->lo = ZD_TIME_MIN;
+		span->hi = ZD_TIME_MAX;
+		if (zone->has_rule) rule_info( &zone->rule, DST, span->lo, &span->info );
+		else ttinfo_info( zone, 0, 0, span->lo, &span->info );
+		if (!zone->has_rule || !zone->rule.has_dst) return;
+	}
+
+	/// rule-expanded: bounded by the rule edges either side of t
+	span->index = zone->timecnt;
+	span->hi = rule_after( &zone->rule, t, &span->year, &span->pos );
+	year = span->pos ? span->year : span->year - 1;
+	pos = !span->pos;
+	i = rule_edge_pos( &zone->rule, year, pos, &span->lo );
+	if (span->lo > last) rule_info( &zone->rule, i, span->lo, &span->info );
+	else transition_span( zone, zone->timecnt - 1, span );
+}
+
+int zdzone_next_span( const zdzone* zone, zdspan* span )
+{
+	int i;
+
+	if (span->hi == ZD_TIME_MAX) return 0;
+	if (span->index + 1 < zone->timecnt)
+	{
+		transition_span( zone, span->index + 1, span );
+		return 1;
+	}
+	/// rule-expanded: edge (year, pos) begins the next interval
+	span->index = zone->timecnt;
+	i = rule_edge_pos( &zone->rule, span->year, span->pos, &span->lo );
+	rule_info( &zone->rule, i, span->lo, &span->info );
+	if (span->pos) span->year++;
+	span->pos = !span->pos;
+	rule_edge_pos( &zone->rule, span->year, span->pos, &span->hi );
+	return 1;
+}
+
+
+void zditer_init( zditer* iter, const zdzone* zone, const time_t start, const time_t end )
+{
+	iter->zone = zone;
+	iter->start = start;
+	iter->end = end;
+	iter->started = 0;
+	zdzone_span( zone, start, &iter->span );
+}
+
+int zditer_next( zditer* iter, zdumpinfo* entry )
+{
+	if (!iter->started)
+	{
+		iter->started = 1;
+		if (iter->end < iter->start) return 0;
+		*entry = iter->span.info;
+		entry->start = iter->start;
+		return 1;
+	}
+	if (iter->span.hi > iter->end) return 0;
+	if (!zdzone_next_span( iter->zone, &iter->span )) return 0;
+	*entry = iter->span.info;
+	return 1;
+}
+
+
+void zdcursor_init( zdcursor* cursor, const zdzone* zone )
+{
+	cursor->zone = zone;
+	cursor->valid = 0;
+}
+
+const zdumpinfo* zdcursor_lookup( zdcursor* cursor, const time_t t )
+{
+	int i;
+
+	if (cursor->valid && (t >= cursor->span.lo))
+	{
+		if (t < cursor->span.hi) return &cursor->span.info;
+		for (i=0; i<ZD_CURSOR_STEPS; i++)
+		{
+			if (!zdzone_next_span( cursor->zone, &cursor->span )) break;
+			if (t < cursor->span.hi) return &cursor->span.info;
+		}
 	}
+	zdzone_span( cursor->zone, t, &cursor->span );
+	cursor->valid = 1;
+	return &cursor->span.info;
+}
+
+
+#define ZD_HORIZON_MAX 100000	/// latest horizon year accepted
+
+int zdtimeline_build( const zdzone* zone, const long horizon, zdtimeline** timeline )
+{
+	zdtimeline* tl;
+	zdumpinfo* new_entries;
+	zdspan span;
+	int max_entries = 0;
+	int more;
+
+	*timeline = NULL;
+	if ((horizon < ZD_TIMELINE_FROM) || (horizon > ZD_HORIZON_MAX)) return ZD_BAD_VALUES;
+	tl = calloc( 1, sizeof(zdtimeline) );
+	if (tl == NULL) return ZD_MALLOC;
+	tl->zone = zone;
+	tl->horizon = horizon;
+	tl->end = (time_t) days_from_civil( horizon + 1, 1, 1 ) * SECS_PER_DAY;
+
+	/// a zone that is all footer rule has no earliest interval
+	tl->begin = ZD_TIME_MIN;
+	if (!zone->timecnt && zone->has_rule && zone->rule.has_dst)
+		tl->begin = (time_t) days_from_civil( ZD_TIMELINE_FROM, 1, 1 ) * SECS_PER_DAY;
+
+	/// every interval beginning before the end of the horizon year
+	zdzone_span( zone, tl->begin, &span );
+	do
+	{
+		if (tl->num_entries == max_entries)
+		{
+			max_entries = max_entries ? max_entries * 2 : 64;
+			new_entries = realloc( tl->entries, sizeof(zdumpinfo) * max_entries );
+			if (new_entries == NULL)
+			{
+				zdtimeline_free(tl);
+				return ZD_MALLOC;
+			}
+			tl->entries = new_entries;
+		}
+		tl->entries[tl->num_entries++] = span.info;
+		more = span.hi < tl->end;
+	} while (more && zdzone_next_span( zone, &span ));
+	if (span.hi == ZD_TIME_MAX) tl->end = ZD_TIME_MAX;
+
+	/// give back what the doubling reserved
+	new_entries = realloc( tl->entries, sizeof(zdumpinfo) * tl->num_entries );
+	if (new_entries != NULL) tl->entries = new_entries;
+	*timeline = tl;
+	return ZD_SUCCESS;
+}
+
+void zdtimeline_free( zdtimeline* timeline )
+{
+	if (timeline == NULL) return;
+	free(timeline->entries);
+	free(timeline);
+}
+
+size_t zdtimeline_size( const zdtimeline* timeline )
+{
+	return sizeof(zdtimeline) + (sizeof(zdumpinfo) * timeline->num_entries);
+}
+
+static int timeline_find( const zdtimeline* timeline, const time_t t )
+{
+	/// the last entry starting at or before t, given t >= begin
+	int lo = 0;
+	int hi = timeline->num_entries - 1;
+	int mid;
+
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo + 1) / 2);
+		if (timeline->entries[mid].start <= t) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+int zdtimeline_slice( const zdtimeline* timeline, const time_t start, const time_t end,
+					  const zdumpinfo** entries, int* num_entries )
+{
+	int first;
+
+	*entries = NULL;
+	*num_entries = 0;
+	if (end < start) return ZD_BAD_VALUES;
+	if ((start < timeline->begin) ||
+		((end >= timeline->end) && (timeline->end != ZD_TIME_MAX)))
+		return ZD_HORIZON;
+	first = timeline_find( timeline, start );
+	*entries = &timeline->entries[first];
+	*num_entries = timeline_find( timeline, end ) - first + 1;
+	return ZD_SUCCESS;
+}
+
+static void span_type( const zdzone* zone, const zdspan* span,
+					   const char** abbr, int* is_dst )
+{
+	/// the abbreviation, within the zone itself, and the dst flag of the
+	/// local time type in effect during span. Within the footer rule, that
+	/// is DST when the edge ending the span is the rule leaving DST; two
+	/// states may share an abbreviation, so it cannot tell them apart
+	const zdttinfo* info;
+	time_t edge;
+	int i;
+
+	if ((span->index >= zone->timecnt) || ((span->index < 0) && zone->has_rule && !zone->timecnt))
+	{
+		i = STD;
+		if (zone->rule.has_dst && (span->hi != ZD_TIME_MAX))
+			i = rule_edge_pos( &zone->rule, span->year, span->pos, &edge );
+		*abbr = zone->rule.abbr[i];
+		*is_dst = i == DST;
+		return;
+	}
+	info = &zone->ttinfo[ span->index < 0 ? 0 : zone->types[span->index] ];
+	*abbr = info->abbr;
+	*is_dst = info->is_dst;
+}
+
+struct tm* zdump_gmtime_r( const time_t t, struct tm* result )
+{
+	long days = days_of_time(t);
+	long secs = t % SECS_PER_DAY;
+	long year;
+	int  month, day;
+
+	if (secs < 0) secs += SECS_PER_DAY;
+	civil_from_days( days, &year, &month, &day );
+	if ((year - 1900 > INT_MAX) || (year - 1900 < INT_MIN)) return NULL;
+	result->tm_year = (int) (year - 1900);
+	result->tm_mon = month - 1;
+	result->tm_mday = day;
+	result->tm_hour = (int) (secs / 3600);
+	result->tm_min = (int) ((secs % 3600) / 60);
+	result->tm_sec = (int) (secs % 60);
+	result->tm_wday = (int) (((days % 7) + 11) % 7);
+	result->tm_yday = (int) (days - days_from_civil( year, 1, 1 ));
+	result->tm_isdst = 0;
+	result->tm_gmtoff = 0;
+	result->tm_zone = "GMT";
 	return result;
 }
+
+time_t zdump_timegm( const struct tm* tm )
+{
+	long year = tm->tm_year + 1900L + (tm->tm_mon / 12);
+	int  month = tm->tm_mon % 12;
+
+	if (month < 0)
+	{
+		month += 12;
+		year--;
+	}
+	return ((time_t) (days_from_civil( year, month + 1, 1 ) + tm->tm_mday - 1) * SECS_PER_DAY)
+		   + (tm->tm_hour * 3600L) + (tm->tm_min * 60L) + tm->tm_sec;
+}
+
+static struct tm* span_localtime( const zdzone* zone, const zdspan* span,
+								  const time_t t, struct tm* result )
+{
+	/// local times beyond the range of time_t cannot be broken down
+	if ((span->info.utc_offset > 0) ? (t > ZD_TIME_MAX - span->info.utc_offset)
+									 : (t < ZD_TIME_MIN - span->info.utc_offset)) return NULL;
+	if (zdump_gmtime_r( t + span->info.utc_offset, result ) == NULL) return NULL;
+	result->tm_gmtoff = span->info.utc_offset;
+	span_type( zone, span, &result->tm_zone, &result->tm_isdst );
+	return result;
+}
+
+struct tm* zdump_localtime_r( const zdzone* zone, const time_t t, struct tm* result )
+{
+	zdspan span;
+
+	zdzone_span( zone, t, &span );
+	return span_localtime( zone, &span, t, result );
+}
+
+int zdump_localtime_batch( const zdzone* zone, const time_t* times, const int num_times,
+						   struct tm* results )
+{
+	zdcursor cursor;
+	int i;
+
+	zdcursor_init( &cursor, zone );
+	for (i=0; i<num_times; i++)
+	{
+		zdcursor_lookup( &cursor, times[i] );
+		if (span_localtime( zone, &cursor.span, times[i], &results[i] ) == NULL)
+			return ZD_FAILURE;
+	}
+	return ZD_SUCCESS;
+}
+
+/// zdmerge_node - one per-zone iterator of zdump_multi's heap
+typedef struct {
+	zditer		iter;
+	zdmultiinfo	head;	/// the iterator's next entry
+	} zdmerge_node;
+
+static int merge_before( const zdmerge_node* a, const zdmerge_node* b )
+{
+	if (a->head.info.start != b->head.info.start)
+		return a->head.info.start < b->head.info.start;
+	return a->head.zone_id < b->head.zone_id;
+}
+
+static void merge_sift_down( zdmerge_node* heap, const int heap_len, int i )
+{
+	zdmerge_node temp;
+	int child;
+
+	while ((child = (2 * i) + 1) < heap_len)
+	{
+		if ((child + 1 < heap_len) && merge_before( &heap[child+1], &heap[child] )) child++;
+		if (!merge_before( &heap[child], &heap[i] )) break;
+		temp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = temp;
+		i = child;
+	}
+}
+
+int zdump_multi( char** zones, const int num_zones, const time_t start, const time_t end,
+				 int* num_entries, void** return_data )
+{
+	zdzone** zone = NULL;		/// zones parsed here, NULL where cached
+	const zdzone** cached = NULL;
+	zdmerge_node* heap = NULL;
+	int heap_len = 0;
+	size_t ret_buff_size = 0;
+	void* new_ret;
+	int result = ZD_SUCCESS;
+	int i;
+
+	*num_entries = 0;
+	*return_data = NULL;
+	if (end < start) return ZD_BAD_VALUES;
+	if (num_zones <= 0) return ZD_ZONE_COUNT;
+	zone = calloc( num_zones, sizeof(zdzone*) );
+	cached = calloc( num_zones, sizeof(zdzone*) );
+	heap = malloc( num_zones * sizeof(zdmerge_node) );
+	if ((zone == NULL) || (cached == NULL) || (heap == NULL)) {result= ZD_MALLOC; goto endpoint;};
+
+	/// each zone contributes at least its state at time_t start
+	for (i=0; i<num_zones; i++)
+	{
+		result = zone_get( zones[i], &cached[i], &zone[i] );
+		if (result != ZD_SUCCESS) goto endpoint;
+		if (zone[i] != NULL) cached[i] = NULL;
+		zditer_init( &heap[heap_len].iter, cached[i] != NULL ? cached[i] : zone[i],
+					 start, end );
+		heap[heap_len].head.zone_id = i;
+		if (zditer_next( &heap[heap_len].iter, &heap[heap_len].head.info )) heap_len++;
+	}
+	for (i=(heap_len/2)-1; i>=0; i--) merge_sift_down( heap, heap_len, i );
+
+	while (heap_len)
+	{
+		if ((size_t) *num_entries * sizeof(zdmultiinfo) >= ret_buff_size)
+		{
+			ret_buff_size = ret_buff_size ? ret_buff_size * 2 : sizeof(zdmultiinfo) * num_zones * 2;
+			new_ret = realloc( *return_data, ret_buff_size );
+			if (new_ret == NULL) {result= ZD_MALLOC; goto endpoint;};
+			*return_data = new_ret;
+		}
+		((zdmultiinfo*) *return_data)[*num_entries] = heap[0].head;
+		*num_entries = *num_entries + 1;
+		if (!zditer_next( &heap[0].iter, &heap[0].head.info )) heap[0] = heap[--heap_len];
+		merge_sift_down( heap, heap_len, 0 );
+	}
+
+/// cleanup and exit
+endpoint:
+	if (zone != NULL) for (i=0; i<num_zones; i++) zdzone_free(zone[i]);
+	if (cached != NULL) for (i=0; i<num_zones; i++) zdcache_put(cached[i]);
+	free(zone);
+	free(cached);
+	free(heap);
+	if ((result != ZD_SUCCESS) || !(*num_entries))
+	{
+		free(*return_data);
+		*return_data = NULL;
+		*num_entries = 0;
+		if (result == ZD_SUCCESS) result = ZD_FAILURE;
+	}
+	return result;
+}
+
+
+/// zddb - the zones of a zoneinfo directory
+static int zddb_add( zddb* db, char* path, const char* name, int* zone_id )
+{
+	zdzone* zone;
+	zdzone** new_zones;
+	char** new_names;
+	int result;
+
+	result = zdzone_load( path, &zone );
+	if (result != ZD_SUCCESS) return result;
+	new_zones = realloc( db->zones, sizeof(zdzone*) * (db->num_zones + 1) );
+	if (new_zones != NULL) db->zones = new_zones;
+	new_names = realloc( db->names, sizeof(char*) * (db->num_zones + 1) );
+	if (new_names != NULL) db->names = new_names;
+	if ((new_zones == NULL) || (new_names == NULL) ||
+		((db->names[db->num_zones] = strdup(name)) == NULL))
+	{
+		zdzone_free(zone);
+		return ZD_MALLOC;
+	}
+	db->zones[db->num_zones] = zone;
+	*zone_id = db->num_zones;
+	db->num_zones++;
+	return ZD_SUCCESS;
+}
+
+static int zddb_scan( zddb* db, char* path, size_t root_len )
+{
+	/// add every TZif file below 'path', which has room for PATH_MAX.
+	/// Symbolic links (aliases, 'localtime') and the 'posix' and 'right'
+	/// duplicate trees are skipped; so are files that are not TZif.
+	DIR* dir;
+	struct dirent* entry;
+	struct stat file_status;
+	size_t path_len = strlen(path);
+	int zone_id;
+	int result = ZD_SUCCESS;
+
+	dir = opendir(path);
+	if (dir == NULL) return ZD_DIR_PATH;
+	while ((result == ZD_SUCCESS) && ((entry = readdir(dir)) != NULL))
+	{
+		if ((entry->d_name[0] == '.') || !strcmp(entry->d_name, "posix") ||
+			!strcmp(entry->d_name, "right")) continue;
+		if (path_len + strlen(entry->d_name) + 2 > PATH_MAX) continue;
+		path[path_len] = '/';
+		strcpy( &path[path_len + 1], entry->d_name );
+		if (lstat( path, &file_status ) == 0)
+		{
+			if (S_ISDIR(file_status.st_mode)) result = zddb_scan( db, path, root_len );
+			else if (S_ISREG(file_status.st_mode) &&
+					 (zddb_add( db, path, &path[root_len + 1], &zone_id ) == ZD_MALLOC))
+				result = ZD_MALLOC;
+		}
+		path[path_len] = '\0';
+	}
+	closedir(dir);
+	return result;
+}
+
+int zddb_load( const char* tzdir, zddb** db )
+{
+	char* tzdirlist[2] = { "/usr/share/zoneinfo",	/// libc >= 5.4.6
+						   "/usr/lib/zoneinfo" };	/// libc <  5.4.6
+	char path[PATH_MAX];
+	struct stat dir_status;
+	int result;
+
+	*db = NULL;
+	/// a directory asked for must exist; it is made absolute, as zones
+	/// are later loaded by their path below it
+	if (tzdir != NULL)
+	{
+		if (stat( tzdir, &dir_status ) || !S_ISDIR(dir_status.st_mode)) return ZD_DIR_PATH;
+	}
+	else
+	{
+		tzdir = getenv("TZDIR");
+		if ((tzdir == NULL) || stat( tzdir, &dir_status ) || !S_ISDIR(dir_status.st_mode))
+			tzdir = stat( tzdirlist[0], &dir_status ) ? tzdirlist[1] : tzdirlist[0];
+	}
+	if (realpath( tzdir, path ) == NULL) return ZD_DIR_PATH;
+
+	*db = calloc( 1, sizeof(zddb) );
+	if (*db == NULL) return ZD_MALLOC;
+	(*db)->tzdir = strdup(path);
+	if ((*db)->tzdir == NULL) result = ZD_MALLOC;
+	else result = zddb_scan( *db, path, strlen(path) );
+	if ((result == ZD_SUCCESS) && !(*db)->num_zones) result = ZD_FOPEN;
+	if (result != ZD_SUCCESS)
+	{
+		zddb_free(*db);
+		*db = NULL;
+	}
+	return result;
+}
+
+int zddb_find( const zddb* db, const char* name )
+{
+	int i;
+
+	for (i=0; i<db->num_zones; i++) if (!strcmp( db->names[i], name )) return i;
+	return -1;
+}
+
+int zddb_reload( zddb* db, const char* name, int* zone_id )
+{
+	char path[PATH_MAX];
+	zdzone* zone;
+	int result;
+
+	if (strlen(db->tzdir) + strlen(name) + 2 > PATH_MAX) return ZD_FOPEN;
+	sprintf( path, "%s/%s", db->tzdir, name );
+	*zone_id = zddb_find( db, name );
+	if (*zone_id < 0) return zddb_add( db, path, name, zone_id );
+	result = zdzone_load( path, &zone );
+	if (result != ZD_SUCCESS) return result;
+	zdzone_free( db->zones[*zone_id] );
+	db->zones[*zone_id] = zone;
+	return ZD_SUCCESS;
+}
+
+void zddb_free( zddb* db )
+{
+	int i;
+
+	if (db == NULL) return;
+	for (i=0; i<db->num_zones; i++)
+	{
+		zdzone_free( db->zones[i] );
+		free( db->names[i] );
+	}
+	free(db->zones);
+	free(db->names);
+	free(db->tzdir);
+	free(db);
+}
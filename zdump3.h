@@ -18,7 +18,15 @@
  *  You should have received a copy of the GNU General Public License
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
- 
+#ifndef ZDUMP3_H
+#define ZDUMP3_H
+#include <time.h>		/// for time_t
+#include <limits.h>		/// for LONG_MIN, LONG_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /// zdumpinfo - an element of the array to return
 #define MAX_TZ_ABBR_SIZE   10  /// safe
 typedef struct {
@@ -56,3 +64,304 @@ zdump(                   /// returns 0 on success, -1 on failure
 #define ZD_FREAD       5004 /** unable to read file */
 #define ZD_MALLOC      5005 /** memory allocation error */
 #define ZD_TZIF_HEADER 5006 /** unable to parse tzif header */
+#define ZD_ZONE_COUNT  5007 /** no zones requested */
+#define ZD_TZIF_TRUNC  5008 /** tzif file shorter than its headers state */
+#define ZD_PROTOCOL    5009 /** malformed zdumpd request or reply */
+#define ZD_HORIZON     5010 /** interval extends past a timeline's horizon */
+#define ZD_TZ_STRING   5011 /** unparsable POSIX TZ string */
+
+
+/// zdump_posix - as zdump(), for a zone given as a POSIX TZ string
+/// rather than a name. The decoded string is kept in the zone cache
+/// (zdcache.h), so that repeated calls do no parsing and no file I/O.
+extern int
+zdump_posix(             /// returns 0 on success, error code on failure
+    const char* tz,      /// a POSIX TZ string, as for zdzone_posix()
+    const time_t start,
+    const time_t end,
+    int* num_entries,    /// as for zdump()
+    void** return_data   /// as for zdump()
+           );
+
+
+/// rule_detail - a decoded POSIX TZ rule, as found at the end of a
+/// version 2 TZif file. Offsets are in POSIX sense (seconds WEST of UTC).
+/// Index 0 describes the transition into DST, index 1 the transition
+/// back out of it.
+typedef struct {
+	char type[2];		/// 'J' (1-365, no leap day), 'N' (0-365) or 'M' (m.w.d)
+	char abbr[2][MAX_TZ_ABBR_SIZE];
+	int j[2];
+	int m[2];
+	int w[2];
+	int d[2];
+	int offset[2];
+	int start_time[2];	/// seconds after local midnight, may be negative
+	int hour[2];
+	int min[2];
+	int sec[2];
+	int has_dst;
+	int save_secs[2];
+	} rule_detail;
+
+
+/// zdttinfo - one 'local time type' of a TZif file
+typedef struct {
+	int		utc_offset;	/// in seconds
+	int		is_dst;
+	char	abbr[MAX_TZ_ABBR_SIZE]; /// terminate with '\0'
+	} zdttinfo;
+
+/// zdzone - a TZif file, parsed once into memory
+typedef struct {
+	int			timecnt;		/// number of explicit transitions
+	int			typecnt;		/// number of local time types
+	time_t		*transitions;	/// [timecnt] ascending transition times
+	unsigned char *types;		/// [timecnt] index into ttinfo
+	int			*save_secs;		/// [timecnt] save_secs of each transition
+	zdttinfo	*ttinfo;		/// [typecnt]
+	int			has_rule;		/// footer rule applies after the last transition
+	rule_detail	rule;
+	int			is_fixed;		/// one local time type at all times (no
+	zdumpinfo	fixed;			///    transitions and no DST rule), found at
+								///    load, and its state from ZD_TIME_MIN
+	} zdzone;
+
+extern int
+zdzone_load(             /// returns 0 on success, error code on failure
+    char* tzname,        /// as for zdump()
+    zdzone** zone        /// upon successful return, a malloc()ed zone that
+                         ///    must be released with zdzone_free()
+           );
+
+extern void
+zdzone_free( zdzone* zone );
+
+extern int
+zdzone_posix(            /// returns 0 on success, error code on failure
+    const char* tz,      /// a POSIX TZ string (eg. EST5EDT,M3.2.0,M11.1.0),
+                         ///    as for the TZ environment variable or the
+                         ///    footer of a TZif file; no file is read
+    zdzone** zone        /// upon successful return, a malloc()ed zone with
+                         ///    no explicit transitions, to be released with
+                         ///    zdzone_free()
+            );
+
+extern size_t
+zdzone_size( const zdzone* zone );  /// bytes held by a parsed zone
+
+
+/// footer rules are expanded over the years whose rule edges all fit in a
+/// time_t; beyond them a zone's first and last intervals are unbounded
+#if LONG_MAX > 2147483647L
+#define ZD_YEAR_MIN (-292277022656L)
+#define ZD_YEAR_MAX 292277026595L
+#else
+#define ZD_YEAR_MIN 1902L
+#define ZD_YEAR_MAX 2037L
+#endif
+
+/// zdspan - the interval [lo, hi) of a zone during which one local time
+/// type is in effect. Intervals beyond the last explicit transition are
+/// expanded from the footer rule.
+#define ZD_TIME_MIN ((time_t) LONG_MIN)
+#define ZD_TIME_MAX ((time_t) LONG_MAX)
+typedef struct {
+	time_t		lo;			/// ZD_TIME_MIN before the first transition
+	time_t		hi;			/// ZD_TIME_MAX if there is no further transition
+	int			index;		/// transition in effect (-1 before the first,
+							///    timecnt inside the rule-expanded range)
+	long		year;		/// rule edge (year, pos) that begins at 'hi',
+	int			pos;		///    when 'hi' comes from the footer rule
+	zdumpinfo	info;		/// the state in effect; info.start == lo
+	} zdspan;
+
+extern void
+zdzone_span( const zdzone* zone, const time_t t, zdspan* span );
+                         /// find the interval containing t
+
+extern int
+zdzone_next_span( const zdzone* zone, zdspan* span );
+                         /// advance to the following interval;
+                         ///    returns 0 if there is none
+
+
+/// zditer - iterate over a zone's transitions for the interval start to
+/// end. The first entry is always the tz state at time_t start, exactly
+/// as for zdump().
+typedef struct {
+	const zdzone *zone;
+	time_t		start;
+	time_t		end;
+	zdspan		span;
+	int			started;
+	} zditer;
+
+extern void
+zditer_init( zditer* iter, const zdzone* zone, const time_t start, const time_t end );
+
+extern int
+zditer_next( zditer* iter, zdumpinfo* entry );
+                         /// returns 1 and fills *entry, or 0 when done
+
+
+/// zdcursor - remembers the interval found by the previous lookup, for
+/// streams of mostly increasing timestamps. Lookups that stay within that
+/// interval are answered without any search; those that move forward step
+/// through the following intervals, including rule-expanded ones. Use one
+/// cursor per thread or per stream; the zone itself is never modified.
+#define ZD_CURSOR_STEPS 4   /// forward steps tried before searching afresh
+typedef struct {
+	const zdzone *zone;
+	zdspan		span;
+	int			valid;
+	} zdcursor;
+
+extern void
+zdcursor_init( zdcursor* cursor, const zdzone* zone );
+
+extern const zdumpinfo*
+zdcursor_lookup( zdcursor* cursor, const time_t t );
+                         /// returns the state in effect at t; info.start is
+                         ///    the start of its interval. The pointer is
+                         ///    valid until the next call for this cursor.
+
+
+/// zdtimeline - every interval of a zone, explicit and rule-expanded,
+/// through the end of year 'horizon', materialized once. Its entries are
+/// immutable, so any number of threads may take slices of it; a slice is a
+/// view into the entries, with no allocation or copying per query. A zone
+/// having only a footer rule is expanded from ZD_TIMELINE_FROM.
+#define ZD_TIMELINE_FROM 1900
+typedef struct {
+	const zdzone *zone;		/// built from; not owned
+	long		horizon;	/// last year of rule-expanded intervals
+	time_t		begin;		/// entries answer times from this, normally
+							///    ZD_TIME_MIN,
+	time_t		end;		///    to before this, or ZD_TIME_MAX when the
+							///    zone has no further transitions
+	int			num_entries;
+	zdumpinfo	*entries;	/// [num_entries] ascending
+	} zdtimeline;
+
+extern int
+zdtimeline_build(        /// returns 0 on success, error code on failure
+    const zdzone* zone,  /// must outlive the timeline
+    const long horizon,  /// year through which to expand the footer rule,
+                         ///    from ZD_TIMELINE_FROM to 100000
+    zdtimeline** timeline /// upon successful return, a malloc()ed timeline
+                         ///    to be released with zdtimeline_free()
+                );
+
+extern void
+zdtimeline_free( zdtimeline* timeline );
+
+extern size_t
+zdtimeline_size( const zdtimeline* timeline );  /// bytes held, as zdzone_size()
+
+extern int
+zdtimeline_slice(        /// returns 0 on success, ZD_BAD_VALUES if end <
+    const zdtimeline* timeline, ///  start, ZD_HORIZON outside begin to end
+    const time_t start,  /// seconds from epoch to be scanned
+    const time_t end,    /// seconds from epoch to be scanned
+    const zdumpinfo** entries, /// upon successful return, points into the
+                         ///    timeline at the same entries zdump() would
+                         ///    return, except that the first keeps the start
+                         ///    of its interval (at or before 'start')
+    int* num_entries     /// upon successful return, their number
+                );
+
+
+/// zdump_localtime_r - the local time in a zone, as localtime_r() would
+/// give it with TZ set to that zone, including the glibc fields tm_gmtoff
+/// and tm_zone. Computed from the zone's own data, without reference to
+/// the TZ environment variable and without taking any lock. tm_zone points
+/// into the zone, and is valid while the zone is.
+extern struct tm*
+zdump_localtime_r(       /// returns result, or NULL if the year overflows
+    const zdzone* zone,
+    const time_t t,
+    struct tm* result
+                 );
+
+extern int
+zdump_localtime_batch(   /// returns 0 on success, -1 on failure
+    const zdzone* zone,
+    const time_t* times, /// array of 'num_times' times to convert, which
+                         ///    is fastest when in ascending order
+    const int num_times,
+    struct tm* results   /// array of 'num_times' results
+                     );
+
+
+extern struct tm*
+zdump_gmtime_r(          /// as gmtime_r(), likewise independent of libc;
+    const time_t t,      ///    returns result, or NULL if the year overflows
+    struct tm* result
+              );
+
+extern time_t
+zdump_timegm( const struct tm* tm );
+                         /// as timegm(), the inverse of zdump_gmtime_r();
+                         ///    out of range fields carry over, and tm is
+                         ///    not modified
+
+
+/// zdmultiinfo - an element of the array returned by zdump_multi
+typedef struct {
+	int			zone_id;	/// index into the 'zones' array
+	zdumpinfo	info;
+	} zdmultiinfo;
+
+extern int
+zdump_multi(             /// returns 0 on success, error code on failure
+    char** zones,        /// array of time-zone names, as for zdump()
+    const int num_zones, /// number of elements in 'zones'
+    const time_t start,  /// seconds from epoch to be scanned
+    const time_t end,    /// seconds from epoch to be scanned
+    int* num_entries,    /// upon successful return, the total number of
+                         ///    entries for all zones. Returns 0 on failure.
+    void** return_data   /// upon successful return, a malloc()ed array of
+                         ///    'num_entries' 'zdmultiinfo', merged into one
+                         ///    ascending chronological order (ties in
+                         ///    zone_id order). Returns NULL on failure.
+          );
+
+
+/// zddb - every zone of a zoneinfo directory, parsed. Zone ids are
+/// indices into 'names' and 'zones', and remain stable across reloads.
+typedef struct {
+	char		*tzdir;		/// the directory scanned
+	int			num_zones;
+	char		**names;	/// [num_zones] relative to tzdir (eg. Asia/Baku)
+	zdzone		**zones;	/// [num_zones]
+	} zddb;
+
+extern int
+zddb_load(               /// returns 0 on success, error code on failure
+    const char* tzdir,   /// directory to scan, ZD_DIR_PATH if it is not
+                         ///    one; if NULL, TZDIR, else the system
+                         ///    zoneinfo directory, as for zdump()
+    zddb** db            /// upon successful return, a malloc()ed database
+                         ///    to be released with zddb_free()
+         );
+
+extern int
+zddb_reload(             /// re-read one zone after it has changed on disk,
+    zddb* db,            ///    adding it if it is new. returns 0 on success,
+    const char* name,    ///    error code on failure, leaving the database
+    int* zone_id         ///    unchanged. *zone_id is set to its zone id.
+           );
+
+extern int
+zddb_find( const zddb* db, const char* name );
+                         /// returns the zone id of 'name', or -1
+
+extern void
+zddb_free( zddb* db );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDUMP3_H */
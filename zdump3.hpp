@@ -0,0 +1,391 @@
+/** zdump3.hpp          http://libhdate.sourceforge.net
+ * C++ interface to zdump3: zone handles that free themselves, transition
+ * views and ranges over the library's own data, and results carrying
+ * either a value or the ZD_* error code. Header only; requires C++20.
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ZDUMP3_HPP
+#define ZDUMP3_HPP
+#include <cstddef>		/// for std::size_t, std::ptrdiff_t
+#include <cstdlib>		/// for std::free
+#include <ctime>		/// for std::tm
+#include <iterator>		/// for std::input_iterator_tag
+#include <memory>		/// for std::unique_ptr
+#include <span>			/// for std::span
+#include <utility>		/// for std::exchange, std::move
+#include <version>		/// for __cpp_lib_expected
+#ifdef __cpp_lib_expected
+#include <expected>		/// for std::expected
+#else
+#include <exception>	/// for std::exception
+#include <variant>		/// for std::variant
+#endif
+#include "zdump3.h"
+#include "zdcache.h"	/// for zdcache_get, zdcache_timeline
+
+/// Nothing here copies the library's results: a Dump owns the array
+/// zdump() allocated, spans view arrays held by a zone or a timeline, and
+/// Transitions iterates a zone's intervals as zditer does, one entry at a
+/// time. A view is valid while the Zone, Timeline or Dump it came from is.
+namespace zdump3 {
+
+/// Error - a ZD_* code, as the C functions return
+struct Error {
+	int		code;
+
+	const char* message() const noexcept
+	{
+		switch (code)
+		{
+		case ZD_BAD_VALUES:  return "time_t start > time_t end";
+		case ZD_DIR_PATH:    return "path to zonetab directory not found";
+		case ZD_FOPEN:       return "file not found";
+		case ZD_FREAD:       return "unable to read file";
+		case ZD_MALLOC:      return "memory allocation error";
+		case ZD_TZIF_HEADER: return "unable to parse tzif header";
+		case ZD_ZONE_COUNT:  return "no zones requested";
+		case ZD_TZIF_TRUNC:  return "tzif file shorter than its headers state";
+		case ZD_PROTOCOL:    return "malformed zdumpd request or reply";
+		case ZD_HORIZON:     return "interval extends past a timeline's horizon";
+		case ZD_TZ_STRING:   return "unparsable POSIX TZ string";
+		default:             return "failure";
+		}
+	}
+	};
+
+
+/// Expected<T> - a T, or the Error that prevented it: std::expected where
+/// the library has it, else a subset of its interface
+#ifdef __cpp_lib_expected
+template <class T> using Expected = std::expected<T, Error>;
+using Unexpected = std::unexpected<Error>;
+#else
+class Unexpected {
+public:
+	explicit Unexpected( const Error& error ) noexcept : err(error) {}
+	const Error& error() const noexcept { return err; }
+private:
+	Error	err;
+	};
+
+class BadExpectedAccess : public std::exception {
+public:
+	explicit BadExpectedAccess( const Error& error ) noexcept : err(error) {}
+	const char* what() const noexcept override { return err.message(); }
+	const Error& error() const noexcept { return err; }
+private:
+	Error	err;
+	};
+
+template <class T> class Expected {
+public:
+	Expected( T&& value ) : v( std::in_place_index<0>, std::move(value) ) {}
+	Expected( const T& value ) : v( std::in_place_index<0>, value ) {}
+	Expected( const Unexpected& u ) : v( std::in_place_index<1>, u.error() ) {}
+
+	bool has_value() const noexcept { return v.index() == 0; }
+	explicit operator bool() const noexcept { return has_value(); }
+
+	T& value() &              { check(); return std::get<0>(v); }
+	const T& value() const &  { check(); return std::get<0>(v); }
+	T&& value() &&            { check(); return std::get<0>(std::move(v)); }
+	T& operator*() &                 { return std::get<0>(v); }
+	const T& operator*() const &     { return std::get<0>(v); }
+	T&& operator*() &&               { return std::get<0>(std::move(v)); }
+	T* operator->()                  { return &std::get<0>(v); }
+	const T* operator->() const      { return &std::get<0>(v); }
+	const Error& error() const noexcept { return std::get<1>(v); }
+
+	template <class U> T value_or( U&& other ) const &
+		{ return has_value() ? std::get<0>(v) : static_cast<T>(std::forward<U>(other)); }
+	template <class U> T value_or( U&& other ) &&
+		{ return has_value() ? std::get<0>(std::move(v)) : static_cast<T>(std::forward<U>(other)); }
+
+private:
+	void check() const { if (!has_value()) throw BadExpectedAccess( std::get<1>(v) ); }
+	std::variant<T, Error> v;
+	};
+#endif
+
+inline Unexpected failed( const int code ) { return Unexpected( Error{code} ); }
+
+
+/// Transitions - the entries zdump() would return for a zone and an
+/// interval, produced one at a time by a zditer; range-for ready
+class Transitions {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = zdumpinfo;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const zdumpinfo*;
+		using reference         = const zdumpinfo&;
+
+		iterator() = default;		/// the end
+		explicit iterator( const zditer& from ) : iter(from), done(false) { ++*this; }
+		reference operator*() const noexcept { return entry; }
+		pointer operator->() const noexcept { return &entry; }
+		iterator& operator++() { done = !zditer_next( &iter, &entry ); return *this; }
+		void operator++(int) { ++*this; }
+		/// only whether both are at the end, or neither is
+		friend bool operator==( const iterator& a, const iterator& b ) noexcept
+			{ return a.done == b.done; }
+	private:
+		zditer		iter {};
+		zdumpinfo	entry {};
+		bool		done = true;
+		};
+
+	Transitions( const zdzone* zone, const time_t start, const time_t end ) noexcept
+		{ zditer_init( &iter, zone, start, end ); }
+	iterator begin() const { return iterator(iter); }
+	iterator end() const noexcept { return iterator(); }
+private:
+	zditer	iter;
+	};
+
+
+/// Timeline - owns a zdtimeline, or holds a cached one (returning its
+/// reference to the zone cache when destroyed); move-only
+class Timeline {
+public:
+	/// the cached zone's timeline, shared with other users of the cache
+	static Expected<Timeline> cached( const char* tzname, const long horizon )
+	{
+		const zdtimeline* tl;
+		int result = zdcache_timeline( const_cast<char*>(tzname), horizon, &tl );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Timeline( const_cast<zdtimeline*>(tl), true );
+	}
+
+	Timeline( Timeline&& other ) noexcept
+		: tl( std::exchange( other.tl, nullptr ) ), in_cache(other.in_cache) {}
+	Timeline& operator=( Timeline&& other ) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			tl = std::exchange( other.tl, nullptr );
+			in_cache = other.in_cache;
+		}
+		return *this;
+	}
+	Timeline( const Timeline& ) = delete;
+	Timeline& operator=( const Timeline& ) = delete;
+	~Timeline() { release(); }
+
+	const zdtimeline* get() const noexcept { return tl; }
+	long horizon() const noexcept { return tl->horizon; }
+	std::span<const zdumpinfo> entries() const noexcept
+		{ return { tl->entries, static_cast<std::size_t>(tl->num_entries) }; }
+
+	/// the entries zdump() would return for start to end, as a view
+	Expected<std::span<const zdumpinfo>> slice( const time_t start, const time_t end ) const
+	{
+		const zdumpinfo* first;
+		int count;
+		int result = zdtimeline_slice( tl, start, end, &first, &count );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return std::span<const zdumpinfo>( first, static_cast<std::size_t>(count) );
+	}
+
+private:
+	friend class Zone;
+	Timeline( zdtimeline* timeline, const bool cached ) noexcept
+		: tl(timeline), in_cache(cached) {}
+	void release() noexcept
+	{
+		if (tl == nullptr) return;
+		if (in_cache) zdcache_put( tl->zone );
+		else zdtimeline_free(tl);
+		tl = nullptr;
+	}
+	zdtimeline	*tl;
+	bool		in_cache;
+	};
+
+
+/// Zone - owns a parsed zone, or holds a cached one (returning its
+/// reference to the zone cache when destroyed); move-only
+class Zone {
+public:
+	static Expected<Zone> load( const char* tzname )	/// as zdzone_load()
+	{
+		zdzone* zone;
+		int result = zdzone_load( const_cast<char*>(tzname), &zone );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Zone( zone, false );
+	}
+
+	static Expected<Zone> posix( const char* tz )		/// as zdzone_posix()
+	{
+		zdzone* zone;
+		int result = zdzone_posix( tz, &zone );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Zone( zone, false );
+	}
+
+	static Expected<Zone> cached( const char* tzname )	/// as zdcache_get()
+	{
+		const zdzone* zone;
+		int result = zdcache_get( const_cast<char*>(tzname), &zone );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Zone( const_cast<zdzone*>(zone), true );
+	}
+
+	static Expected<Zone> cached_posix( const char* tz )	/// as zdcache_posix()
+	{
+		const zdzone* zone;
+		int result = zdcache_posix( tz, &zone );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Zone( const_cast<zdzone*>(zone), true );
+	}
+
+	Zone( Zone&& other ) noexcept
+		: zone( std::exchange( other.zone, nullptr ) ), in_cache(other.in_cache) {}
+	Zone& operator=( Zone&& other ) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			zone = std::exchange( other.zone, nullptr );
+			in_cache = other.in_cache;
+		}
+		return *this;
+	}
+	Zone( const Zone& ) = delete;
+	Zone& operator=( const Zone& ) = delete;
+	~Zone() { release(); }
+
+	const zdzone* get() const noexcept { return zone; }
+	bool is_fixed() const noexcept { return zone->is_fixed; }
+
+	/// the zone's explicit transitions and local time types, as parsed
+	std::span<const time_t> transition_times() const noexcept
+		{ return { zone->transitions, static_cast<std::size_t>(zone->timecnt) }; }
+	std::span<const zdttinfo> types() const noexcept
+		{ return { zone->ttinfo, static_cast<std::size_t>(zone->typecnt) }; }
+
+	zdspan interval( const time_t t ) const noexcept	/// as zdzone_span()
+	{
+		zdspan span;
+
+		zdzone_span( zone, t, &span );
+		return span;
+	}
+
+	zdumpinfo at( const time_t t ) const noexcept		/// the state in effect at t
+		{ return interval(t).info; }
+
+	Transitions transitions( const time_t start, const time_t end ) const noexcept
+		{ return Transitions( zone, start, end ); }
+
+	Expected<std::tm> localtime( const time_t t ) const	/// as zdump_localtime_r()
+	{
+		std::tm result;
+
+		if (zdump_localtime_r( zone, t, &result ) == nullptr) return failed(ZD_BAD_VALUES);
+		return result;
+	}
+
+	/// a timeline of this zone, which must outlive it
+	Expected<Timeline> timeline( const long horizon ) const
+	{
+		zdtimeline* tl;
+		int result = zdtimeline_build( zone, horizon, &tl );
+
+		if (result != ZD_SUCCESS) return failed(result);
+		return Timeline( tl, false );
+	}
+
+private:
+	Zone( zdzone* parsed, const bool cached ) noexcept : zone(parsed), in_cache(cached) {}
+	void release() noexcept
+	{
+		if (zone == nullptr) return;
+		if (in_cache) zdcache_put(zone);
+		else zdzone_free(zone);
+		zone = nullptr;
+	}
+	zdzone	*zone;
+	bool	in_cache;
+	};
+
+
+/// Cursor - a zdcursor over a zone, which must outlive it. As for
+/// zdcursor_lookup(), the state returned is valid until the next lookup.
+class Cursor {
+public:
+	explicit Cursor( const Zone& zone ) noexcept { zdcursor_init( &cursor, zone.get() ); }
+	const zdumpinfo& lookup( const time_t t ) noexcept { return *zdcursor_lookup( &cursor, t ); }
+private:
+	zdcursor	cursor;
+	};
+
+
+/// Dump - owns the array zdump() returned, and views it
+class Dump {
+public:
+	std::span<const zdumpinfo> entries() const noexcept { return { data.get(), count }; }
+	operator std::span<const zdumpinfo>() const noexcept { return entries(); }
+	const zdumpinfo* begin() const noexcept { return data.get(); }
+	const zdumpinfo* end() const noexcept { return data.get() + count; }
+	std::size_t size() const noexcept { return count; }
+	const zdumpinfo& operator[]( const std::size_t i ) const noexcept { return data.get()[i]; }
+
+private:
+	struct Free { void operator()( zdumpinfo* p ) const noexcept { std::free(p); } };
+	friend Expected<Dump> dump( const char*, const time_t, const time_t );
+	friend Expected<Dump> dump_posix( const char*, const time_t, const time_t );
+	Dump( void* entries, const int num_entries ) noexcept
+		: data( static_cast<zdumpinfo*>(entries) ), count( static_cast<std::size_t>(num_entries) ) {}
+	std::unique_ptr<zdumpinfo, Free> data;
+	std::size_t count;
+	};
+
+inline Expected<Dump> dump( const char* tzname, const time_t start, const time_t end )
+{
+	/// as zdump(); tzname nullptr for the system's current timezone
+	void* entries = nullptr;
+	int num_entries;
+	int result = zdump( const_cast<char*>(tzname), start, end, &num_entries, &entries );
+
+	if (result != ZD_SUCCESS) return failed(result);
+	return Dump( entries, num_entries );
+}
+
+inline Expected<Dump> dump_posix( const char* tz, const time_t start, const time_t end )
+{
+	/// as zdump_posix()
+	void* entries = nullptr;
+	int num_entries;
+	int result = zdump_posix( tz, start, end, &num_entries, &entries );
+
+	if (result != ZD_SUCCESS) return failed(result);
+	return Dump( entries, num_entries );
+}
+
+} /* namespace zdump3 */
+
+#endif /* ZDUMP3_HPP */
@@ -0,0 +1,328 @@
+ /** zdumpd.c                           http://libhdate.sourceforge.net
+ *   zdumpd - answer zdump requests over a Unix domain socket
+ *
+ * compile: (presumes zdump3.h in current directory)
+ *     gcc -c -I./ -Wall -Werror -g -pthread zdumpd.c
+ * build: (presumes zdump3 built in current directory)
+ *     gcc -I./ -L./ -Wall -pthread zdumpd.c -o zdumpd -lzdump3
+ * run:
+ *     env LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH ./zdumpd [socket_path] &
+ *
+ * Copyright:  2012 (c) Boruch Baum <zdump@gmx.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>		/// for printf
+#include <stdlib.h>		/// for malloc, free, getenv
+#include <string.h>		/// for memset, strstr
+#include <error.h>		/// for error
+#include <errno.h>		/// for errno
+#include <unistd.h>		/// for read, close, unlink, geteuid
+#include <signal.h>		/// for signal
+#include <pthread.h>	/// for pthread_create
+#include <sys/socket.h>	/// for socket, bind, listen, accept
+#include <sys/un.h>		/// for sockaddr_un
+#include <sys/stat.h>	/// for mkdir, lstat
+#include <sys/time.h>	/// for timeval
+#include <zdclient.h>	/// for the protocol
+#include <zdcache.h>	/// for zdcache_get
+
+/// Zones are parsed on first request and kept in the library's zone
+/// cache for the life of the daemon. A fixed pool of threads each accept
+/// and serve one connection at a time; a connection may carry any number
+/// of requests, but one idle, or stalled mid-request, for IDLE_SECONDS is
+/// closed, so that idle clients cannot hold every worker.
+#define MIN_WORKERS 4
+#define IDLE_SECONDS 2
+
+
+static int io_full( const int fd, void* buffer, size_t len, const int writing )
+{
+	char* next = buffer;
+	ssize_t done;
+
+	while (len)
+	{
+		if (writing) done = send( fd, next, len, MSG_NOSIGNAL );
+		else done = read( fd, next, len );
+		if ((done < 0) && (errno == EINTR)) continue;
+		if (done <= 0) return -1;
+		next += done;
+		len -= done;
+	}
+	return 0;
+}
+
+static int time_supported( const int64_t t )
+{
+	/// as zdumpd_lookup() checks: a time whose date can be broken down
+	struct tm tm;
+
+	return zdump_gmtime_r( (time_t) t, &tm ) != NULL;
+}
+
+static int answer_range( const int fd, const zdzone* zone, const zdp_request* request )
+{
+	zditer iter;
+	zdumpinfo* entries = NULL;
+	zdumpinfo* new_entries;
+	zdp_reply reply;
+	int max_entries = 0;
+	int result;
+
+	reply.result = ZD_SUCCESS;
+	reply.num_entries = 0;
+	if ((request->end < request->start) ||
+		((request->start != ZD_TIME_MIN) && !time_supported(request->start)) ||
+		((request->end != ZD_TIME_MAX) && !time_supported(request->end)))
+		reply.result = ZD_BAD_VALUES;
+	else
+	{
+		zditer_init( &iter, zone, request->start, request->end );
+		while (1)
+		{
+			if (reply.num_entries == ZDP_MAX_ENTRIES)
+			{
+				reply.result = ZD_BAD_VALUES;
+				reply.num_entries = 0;
+				break;
+			}
+			if (reply.num_entries == max_entries)
+			{
+				max_entries = max_entries ? max_entries * 2 : 64;
+				new_entries = realloc( entries, sizeof(zdumpinfo) * max_entries );
+				if (new_entries == NULL)
+				{
+					reply.result = ZD_MALLOC;
+					reply.num_entries = 0;
+					break;
+				}
+				entries = new_entries;
+			}
+			if (!zditer_next( &iter, &entries[reply.num_entries] )) break;
+			reply.num_entries++;
+		}
+		if ((reply.result == ZD_SUCCESS) && !reply.num_entries) reply.result = ZD_FAILURE;
+	}
+	result = io_full( fd, &reply, sizeof(reply), 1 ) ||
+			 io_full( fd, entries, sizeof(zdumpinfo) * reply.num_entries, 1 );
+	free(entries);
+	return result;
+}
+
+static int answer_lookup( const int fd, const zdzone* zone, const zdp_request* request )
+{
+	int64_t* times;
+	zdumpinfo* entries;
+	zdcursor cursor;
+	zdp_reply reply;
+	uint32_t i;
+	int result;
+
+	/// the times are read in full even when there is no room for the
+	/// answer, to keep the connection in step
+	times = malloc( sizeof(int64_t) * (request->num_times + 1) );
+	if (times == NULL) return -1;
+	if (io_full( fd, times, sizeof(int64_t) * request->num_times, 0 ))
+	{
+		free(times);
+		return -1;
+	}
+	entries = malloc( sizeof(zdumpinfo) * (request->num_times + 1) );
+	reply.result = entries != NULL ? ZD_SUCCESS : ZD_MALLOC;
+	for (i=0; (i<request->num_times) && (reply.result == ZD_SUCCESS); i++)
+		if (!time_supported(times[i])) reply.result = ZD_BAD_VALUES;
+	reply.num_entries = reply.result == ZD_SUCCESS ? request->num_times : 0;
+	if (reply.result == ZD_SUCCESS)
+	{
+		zdcursor_init( &cursor, zone );
+		for (i=0; i<request->num_times; i++)
+			entries[i] = *zdcursor_lookup( &cursor, (time_t) times[i] );
+	}
+	free(times);
+	result = io_full( fd, &reply, sizeof(reply), 1 ) ||
+			 io_full( fd, entries, sizeof(zdumpinfo) * reply.num_entries, 1 );
+	free(entries);
+	return result;
+}
+
+static int refuse( const int fd, const int result, const zdp_request* request )
+{
+	/// skip any times of a refused lookup, then reply with only the error
+	zdp_reply reply;
+	int64_t discard[256];
+	uint32_t left = request->op == ZDP_LOOKUP ? request->num_times : 0;
+	uint32_t n;
+
+	while (left)
+	{
+		n = left < 256 ? left : 256;
+		if (io_full( fd, discard, sizeof(int64_t) * n, 0 )) return -1;
+		left -= n;
+	}
+	reply.result = result;
+	reply.num_entries = 0;
+	return io_full( fd, &reply, sizeof(reply), 1 );
+}
+
+static void serve_connection( const int fd )
+{
+	zdp_request request;
+	char name[ZDP_MAX_NAME + 1];
+	const zdzone* zone;
+	int result;
+	int failed = 0;
+
+	while (!failed && !io_full( fd, &request, sizeof(request), 0 ))
+	{
+		/// a malformed request ends the connection: the stream can no
+		/// longer be trusted to be in step
+		if ((request.magic != ZDP_MAGIC) || (request.info_size != sizeof(zdumpinfo)) ||
+			(request.name_len > ZDP_MAX_NAME) ||
+			((request.op != ZDP_RANGE) && (request.op != ZDP_LOOKUP)) ||
+			((request.op == ZDP_LOOKUP) && (request.num_times > ZDP_MAX_TIMES)))
+		{
+			request.op = 0;
+			refuse( fd, ZD_PROTOCOL, &request );
+			break;
+		}
+		if (io_full( fd, name, request.name_len, 0 )) break;
+		name[request.name_len] = '\0';
+
+		/// only names below the zoneinfo directory are served
+		if ((name[0] == '/') || (strstr( name, ".." ) != NULL)) result = ZD_FOPEN;
+		else result = zdcache_get( request.name_len ? name : NULL, &zone );
+		if (result != ZD_SUCCESS)
+		{
+			failed = refuse( fd, result, &request );
+			continue;
+		}
+		if (request.op == ZDP_RANGE) failed = answer_range( fd, zone, &request );
+		else failed = answer_lookup( fd, zone, &request );
+		zdcache_put(zone);
+	}
+	close(fd);
+}
+
+static void* worker( void* arg )
+{
+	int listen_fd = (int) (long) arg;
+	struct timeval idle = { .tv_sec = IDLE_SECONDS, .tv_usec = 0 };
+	int fd;
+
+	while (1)
+	{
+		fd = accept4( listen_fd, NULL, NULL, SOCK_CLOEXEC );
+		if (fd >= 0)
+		{
+			/// a timed out read or send fails, and ends the connection
+			if (setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle) ) ||
+				setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &idle, sizeof(idle) ))
+				close(fd);
+			else serve_connection(fd);
+			continue;
+		}
+		if ((errno == EINTR) || (errno == ECONNABORTED)) continue;
+		if ((errno == EMFILE) || (errno == ENFILE))
+		{
+			sleep(1);
+			continue;
+		}
+		error(1, errno, "accept");
+	}
+	return NULL;
+}
+
+static void socket_dir( const char* path )
+{
+	/// create the default socket's directory, mode 0700, or make sure the
+	/// one there is ours and closed to others, so that no other user can
+	/// take the socket's place
+	char dir[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+	struct stat dir_status;
+
+	strcpy( dir, path );
+	*strrchr( dir, '/' ) = '\0';
+	if (mkdir( dir, 0700 ) && (errno != EEXIST)) error(1, errno, "mkdir %s", dir);
+	if (lstat( dir, &dir_status )) error(1, errno, "%s", dir);
+	if (!S_ISDIR(dir_status.st_mode) || (dir_status.st_uid != geteuid()) ||
+		(dir_status.st_mode & 077))
+		error(1, 0, "%s must be a directory of this user, of mode 0700", dir);
+}
+
+static void socket_clear( const char* path )
+{
+	/// remove a stale socket of ours; anything else at the path is left
+	struct stat file_status;
+
+	if (lstat( path, &file_status ))
+	{
+		if (errno == ENOENT) return;
+		error(1, errno, "%s", path);
+	}
+	if (!S_ISSOCK(file_status.st_mode) || (file_status.st_uid != geteuid()))
+		error(1, 0, "%s is not a socket of this user; not replacing it", path);
+	if (unlink(path)) error(1, errno, "unlink %s", path);
+}
+
+
+int main (int argc, char *argv[])
+{
+	struct sockaddr_un address;
+	const char* path = address.sun_path;
+	pthread_t thread;
+	long num_workers;
+	int in_default_dir = 0;
+	int listen_fd;
+	int i;
+
+	if (argc > 2)
+	{
+		printf("\
+zdumpd: answer zdump requests over a Unix domain socket\n\
+usage: ./zdumpd [socket_path]\n\
+       socket_path defaults to $ZDUMPD_SOCKET, then $XDG_RUNTIME_DIR/%s/%s,\n\
+       then %s/%s\n", ZDUMPD_USER_DIR, ZDUMPD_SOCKET_NAME, ZDUMPD_RUN_DIR, ZDUMPD_SOCKET_NAME);
+		exit(0);
+	}
+	memset( &address, '\0', sizeof(address) );
+	address.sun_family = AF_UNIX;
+	if (argc == 2)
+	{
+		if (strlen(argv[1]) >= sizeof(address.sun_path))
+			error(1, 0, "socket path too long: %s", argv[1]);
+		strcpy( address.sun_path, argv[1] );
+	}
+	else if (zdumpd_socket_path( address.sun_path, sizeof(address.sun_path),
+								 &in_default_dir ) != ZD_SUCCESS)
+		error(1, 0, "socket path too long");
+	if (in_default_dir) socket_dir(path);
+
+	listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+	if (listen_fd < 0) error(1, errno, "socket");
+	socket_clear(path);
+	if (bind( listen_fd, (struct sockaddr*) &address, sizeof(address) ))
+		error(1, errno, "bind %s", path);
+	if (listen( listen_fd, SOMAXCONN )) error(1, errno, "listen %s", path);
+	signal( SIGPIPE, SIG_IGN );
+
+	num_workers = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (num_workers < MIN_WORKERS) num_workers = MIN_WORKERS;
+	for (i=1; i<num_workers; i++)
+		if (pthread_create( &thread, NULL, worker, (void*) (long) listen_fd ))
+			error(1, errno, "pthread_create");
+	worker( (void*) (long) listen_fd );
+	exit(0);
+}